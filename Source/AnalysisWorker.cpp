@@ -0,0 +1,311 @@
+/*
+  ==============================================================================
+
+	Process-wide low priority threads for analysis that is too heavy for the
+	audio thread.
+
+  ==============================================================================
+*/
+
+#include "AnalysisWorker.h"
+
+class AnalysisWorker::WorkerThread : public juce::Thread
+{
+public:
+	WorkerThread(AnalysisWorker& workerToRun, int index)
+		: juce::Thread("CompressorV2 analysis " + juce::String(index)), worker(workerToRun)
+	{
+		startThread(juce::Thread::Priority::low);
+	}
+
+	~WorkerThread() override
+	{
+		stopThread(2000);
+	}
+
+	void run() override
+	{
+		// Polled rather than woken, so the audio thread never has to signal anything
+		while (!threadShouldExit())
+			if (worker.runPass() == 0)
+				wait(10);
+	}
+
+private:
+	AnalysisWorker& worker;
+};
+
+//==============================================================================
+AnalysisWorker::Client::Client()
+	: blocks((size_t)numBlocks), loudnessSteps((size_t)numLoudnessSteps)
+{
+}
+
+size_t AnalysisWorker::Client::getSizeInBytes() const noexcept
+{
+	auto bytes = sizeof(*this) + blocks.capacity() * sizeof(Block) + loudnessSteps.capacity() * sizeof(LoudnessStep);
+
+	for (const auto& analysis : analyses)
+		bytes += analysis->getSizeInBytes();
+
+	return bytes;
+}
+
+void AnalysisWorker::Client::prepare(double newSampleRate, int newNumChannels) noexcept
+{
+	newNumChannels = juce::jmin(newNumChannels, maxChannels);
+
+	// Hosts prepare on every transport start; that mustn't restart integrated measurements
+	if (newSampleRate == sampleRate.load(std::memory_order_relaxed) && newNumChannels == numChannels.load(std::memory_order_relaxed))
+		return;
+
+	sampleRate.store(newSampleRate, std::memory_order_relaxed);
+	numChannels.store(newNumChannels, std::memory_order_relaxed);
+	droppedStepsAtPrepare.store(droppedLoudnessSteps.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	generation.fetch_add(1, std::memory_order_release);
+}
+
+void AnalysisWorker::Client::pushLoudness(const Dsp::LoudnessSteps& input, const Dsp::LoudnessSteps& output) noexcept
+{
+	const auto numSteps = juce::jmin(input.count, output.count);
+
+	if (loudnessFifo.getFreeSpace() < numSteps)
+	{
+		droppedLoudnessSteps.fetch_add((juce::uint64)numSteps, std::memory_order_relaxed);
+	}
+	else if (numSteps > 0)
+	{
+		const auto writer = loudnessFifo.write(numSteps);
+		auto step = 0;
+
+		const auto fill = [&](int start, int size)
+		{
+			for (int i = start; i < start + size; ++i, ++step)
+			{
+				loudnessSteps[(size_t)i] = { input.meanSquare[(size_t)step], output.meanSquare[(size_t)step],
+					generation.load(std::memory_order_relaxed) };
+			}
+		};
+
+		fill(writer.startIndex1, writer.blockSize1);
+		fill(writer.startIndex2, writer.blockSize2);
+	}
+
+	// The meters had no room for this call's last few steps
+	if (input.lost > 0 || output.lost > 0)
+	{
+		droppedLoudnessSteps.fetch_add((juce::uint64)juce::jmax(input.lost, output.lost), std::memory_order_relaxed);
+	}
+}
+
+int AnalysisWorker::Client::run(int maxBlocks)
+{
+	const auto reader = fifo.read(juce::jmin(maxBlocks, fifo.getNumReady()));
+	const auto current = generation.load(std::memory_order_acquire);
+
+	if (analysedGeneration != current)
+	{
+		// The analyses start again, so only steps lost since the prepare count against them
+		analysedGeneration = current;
+		analysedDroppedSteps = droppedStepsAtPrepare.load(std::memory_order_relaxed);
+
+		for (auto& analysis : analyses)
+			analysis->reset(sampleRate.load(std::memory_order_relaxed), numChannels.load(std::memory_order_relaxed));
+	}
+
+	const auto analyse = [this, current](int start, int size)
+	{
+		for (int i = start; i < start + size; ++i)
+		{
+			// Anything queued before the last prepare() is at the old rate or layout
+			if (blocks[(size_t)i].generation != current)
+				continue;
+
+			for (auto& analysis : analyses)
+				analysis->process(blocks[(size_t)i]);
+		}
+	};
+
+	analyse(reader.startIndex1, reader.blockSize1);
+	analyse(reader.startIndex2, reader.blockSize2);
+
+	// Steps are small and few, so they are all taken every turn
+	const auto stepReader = loudnessFifo.read(loudnessFifo.getNumReady());
+
+	const auto analyseLoudness = [this, current](int start, int size)
+	{
+		for (int i = start; i < start + size; ++i)
+		{
+			if (loudnessSteps[(size_t)i].generation != current)
+				continue;
+
+			for (auto& analysis : analyses)
+				analysis->processLoudness(loudnessSteps[(size_t)i]);
+		}
+	};
+
+	analyseLoudness(stepReader.startIndex1, stepReader.blockSize1);
+	analyseLoudness(stepReader.startIndex2, stepReader.blockSize2);
+
+	// Flagged once the steps queued ahead of the gap are in, even if nothing follows it
+	const auto dropped = droppedLoudnessSteps.load(std::memory_order_relaxed);
+
+	if (dropped != analysedDroppedSteps)
+	{
+		analysedDroppedSteps = dropped;
+
+		for (auto& analysis : analyses)
+			analysis->loudnessStepsLost();
+	}
+
+	return reader.blockSize1 + reader.blockSize2 + stepReader.blockSize1 + stepReader.blockSize2;
+}
+
+//==============================================================================
+AnalysisWorker::AnalysisWorker()
+{
+	const auto numThreads = juce::jlimit(1, 2, juce::SystemStats::getNumCpus() / 4);
+
+	for (int i = 0; i < numThreads; ++i)
+		threads.push_back(std::make_unique<WorkerThread>(*this, i + 1));
+}
+
+AnalysisWorker::~AnalysisWorker()
+{
+	threads.clear();
+}
+
+void AnalysisWorker::addClient(std::shared_ptr<Client> client)
+{
+	const juce::ScopedLock lock(clientsLock);
+	clients.push_back(std::move(client));
+}
+
+void AnalysisWorker::removeClient(const Client* client)
+{
+	const juce::ScopedLock lock(clientsLock);
+	clients.erase(std::remove_if(clients.begin(), clients.end(), [client](const auto& c) { return c.get() == client; }), clients.end());
+}
+
+int AnalysisWorker::runPass()
+{
+	std::vector<std::shared_ptr<Client>> turn;
+
+	{
+		const juce::ScopedLock lock(clientsLock);
+
+		if (clients.empty())
+			return 0;
+
+		const auto start = nextClient++ % clients.size();
+		turn.reserve(clients.size());
+
+		for (size_t i = 0; i < clients.size(); ++i)
+			turn.push_back(clients[(start + i) % clients.size()]);
+	}
+
+	auto analysed = 0;
+
+	for (auto& client : turn)
+	{
+		// Another worker has this one; it'll come round again
+		if (client->busy.exchange(true, std::memory_order_acquire))
+			continue;
+
+		analysed += client->run(blocksPerTurn);
+		client->busy.store(false, std::memory_order_release);
+	}
+
+	return analysed;
+}
+
+//==============================================================================
+void GainReductionHistogram::reset(double, int)
+{
+	clear();
+}
+
+void GainReductionHistogram::process(const AnalysisWorker::Block& block)
+{
+	const auto bin = juce::jlimit(0, numBins - 1, (int)-block.gainReductionDb);
+	bins[(size_t)bin].fetch_add((juce::uint32)block.numSamples, std::memory_order_relaxed);
+}
+
+float GainReductionHistogram::getPercentile(float fraction) const noexcept
+{
+	std::array<juce::uint32, numBins> counts;
+	juce::uint64 total{};
+
+	for (int i = 0; i < numBins; ++i)
+		total += counts[(size_t)i] = bins[(size_t)i].load(std::memory_order_relaxed);
+
+	if (total == 0)
+		return 0.f;
+
+	const auto target = (juce::uint64)((double)fraction * (double)total);
+	juce::uint64 below{};
+
+	for (int i = 0; i < numBins; ++i)
+	{
+		below += counts[(size_t)i];
+
+		if (below > target)
+			return -(float)i;
+	}
+
+	return -(float)(numBins - 1);
+}
+
+void GainReductionHistogram::clear() noexcept
+{
+	for (auto& bin : bins)
+		bin.store(0, std::memory_order_relaxed);
+}
+
+//==============================================================================
+void LoudnessAnalysis::reset(double, int)
+{
+	complete = true;
+
+	for (int i = 0; i < 2; ++i)
+	{
+		gates[(size_t)i].reset();
+		readings[(size_t)i].set(gates[(size_t)i], complete);
+	}
+}
+
+void LoudnessAnalysis::processLoudness(const AnalysisWorker::LoudnessStep& step)
+{
+	if (resetRequested.exchange(false, std::memory_order_relaxed))
+		reset(0.0, 0);
+
+	for (int i = 0; i < 2; ++i)
+	{
+		gates[(size_t)i].addStep((double)(i == 0 ? step.input : step.output));
+		readings[(size_t)i].set(gates[(size_t)i], complete);
+	}
+}
+
+void LoudnessAnalysis::loudnessStepsLost()
+{
+	// Momentary and short-term recover within 3 s of a gap; the rest stay short until a reset
+	complete = false;
+
+	for (auto& reading : readings)
+		reading.complete.store(false, std::memory_order_relaxed);
+}
+
+LoudnessAnalysis::Reading LoudnessAnalysis::PublishedReading::get() const noexcept
+{
+	return { momentary.load(std::memory_order_relaxed), shortTerm.load(std::memory_order_relaxed),
+		integrated.load(std::memory_order_relaxed), range.load(std::memory_order_relaxed), complete.load(std::memory_order_relaxed) };
+}
+
+void LoudnessAnalysis::PublishedReading::set(const Dsp::LoudnessGate& gate, bool isComplete) noexcept
+{
+	momentary.store((float)gate.getMomentary(), std::memory_order_relaxed);
+	shortTerm.store((float)gate.getShortTerm(), std::memory_order_relaxed);
+	integrated.store((float)gate.getIntegrated(), std::memory_order_relaxed);
+	range.store((float)gate.getLoudnessRange(), std::memory_order_relaxed);
+	complete.store(isComplete, std::memory_order_relaxed);
+}
@@ -0,0 +1,256 @@
+/*
+  ==============================================================================
+
+	Process-wide low priority threads for analysis that is too heavy for the
+	audio thread.
+
+	Hold it through juce::SharedResourcePointer<AnalysisWorker>, so however
+	many instances are loaded there are only a couple of worker threads.
+	Each instance registers a Client, which owns its analyses and a ring of
+	fixed-size snapshot blocks. The audio thread copies its output and the
+	gain reduction into the ring without locking or allocating; if the ring
+	can't take the whole block, the block is dropped and counted.
+
+	Loudness steps take a ring of their own, a minute and a half deep, as
+	integrated loudness is only right if it sees every step. It only fills
+	if the workers stall for that long; the steps that don't fit are
+	counted, and the worker tells the analyses about the gap on its next
+	turn, whether or not any step follows it.
+
+	The workers visit the clients round-robin and run at most blocksPerTurn
+	blocks of one client before moving on, so a busy instance can't starve
+	the rest. A client is only ever run by one worker at a time, and as the
+	workers share ownership of it, an instance can go away mid-analysis.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Dsp/Loudness.h"
+
+class AnalysisWorker
+{
+public:
+	static constexpr int blockLength{ 256 };
+	static constexpr int maxChannels{ 2 };
+
+	// One snapshot: up to blockLength samples of the first maxChannels output channels
+	struct Block
+	{
+		int numChannels{}, numSamples{};
+		float gainReductionDb{};
+		juce::uint32 generation{};
+		float samples[maxChannels][blockLength];
+	};
+
+	// One 100 ms step's input and output mean square
+	struct LoudnessStep
+	{
+		float input{}, output{};
+		juce::uint32 generation{};
+	};
+
+	// Runs on a worker thread, one block at a time; results are for the owner to publish
+	class Analysis
+	{
+	public:
+		virtual ~Analysis() = default;
+
+		// Called before the first block and whenever the client is prepared again
+		virtual void reset(double sampleRate, int numChannels) = 0;
+		virtual void process(const Block& block) = 0;
+
+		// Every loudness step, in order, whether or not the blocks around it were dropped
+		virtual void processLoudness(const LoudnessStep&) {}
+		// Some steps since the last reset were lost
+		virtual void loudnessStepsLost() {}
+
+		// For the memory report: the analysis and anything it holds on the heap
+		virtual size_t getSizeInBytes() const noexcept = 0;
+	};
+
+	class Client
+	{
+	public:
+		Client();
+
+		// Message thread, before the client is added to the worker
+		void addAnalysis(std::unique_ptr<Analysis> analysis) { analyses.push_back(std::move(analysis)); }
+
+		// Message thread. A change of rate or layout resets the analyses and discards the
+		// blocks already queued; preparing again with the same ones keeps them running.
+		void prepare(double newSampleRate, int newNumChannels) noexcept;
+
+		// Audio thread: never blocks or allocates. The loudness steps, if given, must come from
+		// meters that have seen the same samples, so their steps end together.
+		template <typename SampleType>
+		void push(const SampleType* const* channels, int numChannels, int numSamples, float gainReductionDb,
+			const Dsp::LoudnessSteps* inputLoudness = nullptr, const Dsp::LoudnessSteps* outputLoudness = nullptr) noexcept
+		{
+			if (inputLoudness != nullptr && outputLoudness != nullptr)
+				pushLoudness(*inputLoudness, *outputLoudness);
+
+			const auto needed = (numSamples + blockLength - 1) / blockLength;
+
+			if (needed == 0)
+				return;
+
+			if (fifo.getFreeSpace() < needed)
+			{
+				droppedBlocks.fetch_add((juce::uint64)needed, std::memory_order_relaxed);
+				return;
+			}
+
+			const auto writer = fifo.write(needed);
+			const auto copyChannels = juce::jmin(numChannels, maxChannels);
+			auto offset = 0;
+
+			const auto fill = [&](int start, int size)
+			{
+				for (int i = start; i < start + size; ++i, offset += blockLength)
+				{
+					auto& block = blocks[(size_t)i];
+					block.numChannels = copyChannels;
+					block.numSamples = juce::jmin(blockLength, numSamples - offset);
+					block.gainReductionDb = gainReductionDb;
+					block.generation = generation.load(std::memory_order_relaxed);
+
+					for (int channel = 0; channel < copyChannels; ++channel)
+						for (int sample = 0; sample < block.numSamples; ++sample)
+							block.samples[channel][sample] = (float)channels[channel][offset + sample];
+				}
+			};
+
+			fill(writer.startIndex1, writer.blockSize1);
+			fill(writer.startIndex2, writer.blockSize2);
+		}
+
+		juce::uint64 getDroppedBlocks() const noexcept { return droppedBlocks.load(std::memory_order_relaxed); }
+		juce::uint64 getDroppedLoudnessSteps() const noexcept { return droppedLoudnessSteps.load(std::memory_order_relaxed); }
+
+		// The client, its rings and its analyses
+		size_t getSizeInBytes() const noexcept;
+
+	private:
+		friend class AnalysisWorker;
+
+		static constexpr int numBlocks{ 32 };
+		static constexpr int numLoudnessSteps{ 900 };
+
+		// Audio thread
+		void pushLoudness(const Dsp::LoudnessSteps& input, const Dsp::LoudnessSteps& output) noexcept;
+
+		// Worker thread: returns the number of blocks analysed
+		int run(int maxBlocks);
+
+		juce::AbstractFifo fifo{ numBlocks };
+		std::vector<Block> blocks;
+		std::vector<std::unique_ptr<Analysis>> analyses;
+
+		juce::AbstractFifo loudnessFifo{ numLoudnessSteps };
+		std::vector<LoudnessStep> loudnessSteps;
+
+		std::atomic<double> sampleRate{ 44100.0 };
+		std::atomic<int> numChannels{ 2 };
+		std::atomic<juce::uint32> generation{ 1 };
+		juce::uint32 analysedGeneration{};
+		juce::uint64 analysedDroppedSteps{};
+
+		std::atomic<bool> busy{};
+		std::atomic<juce::uint64> droppedBlocks{}, droppedLoudnessSteps{};
+		// droppedLoudnessSteps as the current generation began
+		std::atomic<juce::uint64> droppedStepsAtPrepare{};
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Client)
+	};
+
+	AnalysisWorker();
+	~AnalysisWorker();
+
+	// Message thread
+	void addClient(std::shared_ptr<Client> client);
+	void removeClient(const Client* client);
+
+	int getNumThreads() const noexcept { return (int)threads.size(); }
+
+private:
+	class WorkerThread;
+
+	static constexpr int blocksPerTurn{ 4 };
+
+	// One pass over the clients, starting where the last one left off; returns the blocks analysed
+	int runPass();
+
+	juce::CriticalSection clientsLock;
+	std::vector<std::shared_ptr<Client>> clients;
+	size_t nextClient{};
+
+	std::vector<std::unique_ptr<WorkerThread>> threads;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisWorker)
+};
+
+//==============================================================================
+// Distribution of the gain reduction over 1 dB bins, readable from any thread
+class GainReductionHistogram : public AnalysisWorker::Analysis
+{
+public:
+	static constexpr int numBins{ 48 };
+
+	void reset(double sampleRate, int numChannels) override;
+	void process(const AnalysisWorker::Block& block) override;
+
+	// Gain reduction in dB (<= 0) not exceeded for the given fraction of the time, 0 with no data
+	float getPercentile(float fraction) const noexcept;
+	void clear() noexcept;
+
+	size_t getSizeInBytes() const noexcept override { return sizeof(*this); }
+
+private:
+	std::array<std::atomic<juce::uint32>, numBins> bins{};
+};
+
+//==============================================================================
+// BS.1770 gating of the input and output loudness steps, readable from any thread
+class LoudnessAnalysis : public AnalysisWorker::Analysis
+{
+public:
+	struct Reading
+	{
+		// LUFS, -inf until there is enough programme; range in LU
+		float momentary, shortTerm, integrated, range;
+		// False once steps have been lost since the last reset: integrated and range miss some programme
+		bool complete;
+	};
+
+	void reset(double sampleRate, int numChannels) override;
+	void process(const AnalysisWorker::Block&) override {}
+	void processLoudness(const AnalysisWorker::LoudnessStep& step) override;
+	void loudnessStepsLost() override;
+
+	Reading getInput() const noexcept { return readings[0].get(); }
+	Reading getOutput() const noexcept { return readings[1].get(); }
+
+	// Any thread: starts integrated loudness and range over with the next step
+	void requestReset() noexcept { resetRequested.store(true, std::memory_order_relaxed); }
+
+	size_t getSizeInBytes() const noexcept override { return sizeof(*this); }
+
+private:
+	struct PublishedReading
+	{
+		static constexpr float silence{ -std::numeric_limits<float>::infinity() };
+		std::atomic<float> momentary{ silence }, shortTerm{ silence }, integrated{ silence }, range{};
+		std::atomic<bool> complete{ true };
+
+		Reading get() const noexcept;
+		void set(const Dsp::LoudnessGate& gate, bool isComplete) noexcept;
+	};
+
+	std::array<Dsp::LoudnessGate, 2> gates;
+	std::array<PublishedReading, 2> readings;
+	std::atomic<bool> resetRequested{};
+	bool complete{ true };
+};
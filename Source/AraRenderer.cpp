@@ -0,0 +1,383 @@
+/*
+  ==============================================================================
+
+	ARA support: clip-based playback from precomputed gain curves.
+
+  ==============================================================================
+*/
+
+#include "AraRenderer.h"
+#include "SharedResources.h"
+
+#if JucePlugin_Enable_ARA
+
+//==============================================================================
+// Runs one source through a Dsp::Compressor at full accuracy, keeping the envelope every GainCurve::step samples
+class CompressorDocumentController::AnalysisJob : public juce::ThreadPoolJob
+{
+public:
+	AnalysisJob(std::unique_ptr<juce::ARAAudioSourceReader> sourceReader, std::shared_ptr<GainCurve> target)
+		: juce::ThreadPoolJob("Gain curve analysis"), reader(std::move(sourceReader)), curve(std::move(target))
+	{
+	}
+
+	JobStatus runJob() override
+	{
+		constexpr int blockSize{ 64 * GainCurve::step };
+
+		const auto numSamples = (juce::int64)reader->lengthInSamples;
+		const auto numChannels = (int)reader->numChannels;
+
+		// Makeup and mix are applied at playback, so the curve is pure gain reduction
+		auto dynamics = curve->settings;
+		dynamics.gain = 0.f;
+		dynamics.mix = 1.f;
+
+		Dsp::Compressor compressor{ juce::SharedResourcePointer<SharedResources>()->getFastMathTables() };
+		compressor.setParameters(dynamics);
+		compressor.prepare(reader->sampleRate, GainCurve::step, numChannels);
+
+		juce::AudioBuffer<float> block(numChannels, blockSize);
+		std::vector<float> gains;
+		gains.reserve((size_t)(numSamples / GainCurve::step + 2));
+		gains.push_back(1.f);
+
+		for (juce::int64 position = 0; position < numSamples; position += blockSize)
+		{
+			if (shouldExit() || curve->cancelled.load())
+				return jobHasFinished;
+
+			const auto length = (int)juce::jmin((juce::int64)blockSize, numSamples - position);
+
+			if (!reader->read(block.getArrayOfWritePointers(), numChannels, position, length))
+				return jobHasFinished;
+
+			for (int offset = 0; offset < length; offset += GainCurve::step)
+			{
+				float* channels[Dsp::MeterBank::maxChannels];
+				const auto numToProcess = juce::jmin(numChannels, Dsp::MeterBank::maxChannels);
+
+				for (int channel = 0; channel < numToProcess; ++channel)
+					channels[channel] = block.getWritePointer(channel, offset);
+
+				compressor.process(channels, numToProcess, juce::jmin(GainCurve::step, length - offset));
+				gains.push_back(juce::Decibels::decibelsToGain(compressor.getEnvelopeDecibels(), -1000.f));
+			}
+		}
+
+		// One more point so interpolation never reads past the end
+		gains.push_back(gains.back());
+
+		curve->gains = std::move(gains);
+		curve->ready.store(true, std::memory_order_release);
+		return jobHasFinished;
+	}
+
+private:
+	std::unique_ptr<juce::ARAAudioSourceReader> reader;
+	std::shared_ptr<GainCurve> curve;
+};
+
+//==============================================================================
+CompressorDocumentController::CompressorDocumentController(const ARA::PlugIn::PlugInEntry* entry, const ARA::ARADocumentControllerHostInstance* instance)
+	: juce::ARADocumentControllerSpecialisation(entry, instance)
+{
+	readAheadThread.startThread();
+	startTimerHz(10);
+}
+
+CompressorDocumentController::~CompressorDocumentController()
+{
+	stopTimer();
+
+	for (auto& entry : entries)
+		entry.curve->cancelled = true;
+
+	pool.removeAllJobs(true, 10000);
+	readAheadThread.stopThread(1000);
+}
+
+juce::ARAPlaybackRenderer* CompressorDocumentController::doCreatePlaybackRenderer() noexcept
+{
+	return new CompressorPlaybackRenderer(getDocumentController(), *this);
+}
+
+juce::ARAAudioSource* CompressorDocumentController::doCreateAudioSource(juce::ARADocument* document, ARA::ARAAudioSourceHostRef hostRef) noexcept
+{
+	auto* source = new juce::ARAAudioSource(document, hostRef);
+	source->addListener(this);
+	return source;
+}
+
+std::shared_ptr<const GainCurve> CompressorDocumentController::getCurve(juce::ARAAudioSource* source, const ChainSettings& settings)
+{
+	auto sourceCurves = 0;
+
+	for (auto& entry : entries)
+	{
+		if (entry.source != source)
+			continue;
+
+		if (GainCurve::hasSameDynamics(entry.curve->settings, settings))
+			return entry.curve->ready.load(std::memory_order_acquire) ? entry.curve : nullptr;
+
+		++sourceCurves;
+	}
+
+	if (!source->isSampleAccessEnabled())
+		return nullptr;
+
+	// Making room cancels the oldest curve for this source, ready or not
+	if (sourceCurves >= maxCurvesPerSource)
+	{
+		auto oldest = std::find_if(entries.begin(), entries.end(), [source](const Entry& entry) { return entry.source == source; });
+		oldest->curve->cancelled = true;
+		entries.erase(oldest);
+	}
+
+	auto curve = std::make_shared<GainCurve>();
+	curve->settings = settings;
+	entries.push_back({ source, curve });
+
+	// The reader is made here, on the message thread, and only read from on the pool
+	pool.addJob(new AnalysisJob(std::make_unique<juce::ARAAudioSourceReader>(source), std::move(curve)), true);
+	return nullptr;
+}
+
+void CompressorDocumentController::didUpdateAudioSourceContent(juce::ARAAudioSource* source, juce::ARAContentUpdateScopes scopeFlags)
+{
+	if (scopeFlags.affectSamples())
+		invalidate(source);
+}
+
+void CompressorDocumentController::willDestroyAudioSource(juce::ARAAudioSource* source)
+{
+	invalidate(source);
+	source->removeListener(this);
+}
+
+void CompressorDocumentController::invalidate(juce::ARAAudioSource* source)
+{
+	// Only this source's curves go; renderers fall back to the live path for it until the next ones are ready
+	for (auto& entry : entries)
+		if (entry.source == source)
+			entry.curve->cancelled = true;
+
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [source](const Entry& entry) { return entry.source == source; }), entries.end());
+	timerCallback();
+}
+
+void CompressorDocumentController::timerCallback()
+{
+	for (auto* renderer : renderers)
+		renderer->refreshCurves();
+}
+
+//==============================================================================
+CompressorPlaybackRenderer::CompressorPlaybackRenderer(ARA::PlugIn::DocumentController* documentController, CompressorDocumentController& documentOwner)
+	: juce::ARAPlaybackRenderer(documentController), owner(documentOwner)
+{
+	owner.addRenderer(this);
+}
+
+CompressorPlaybackRenderer::~CompressorPlaybackRenderer()
+{
+	owner.removeRenderer(this);
+}
+
+void CompressorPlaybackRenderer::prepareToPlay(double newSampleRate, int newMaximumSamplesPerBlock, int newNumChannels,
+	juce::AudioProcessor::ProcessingPrecision, AlwaysNonRealtime alwaysNonRealtime)
+{
+	sampleRate = newSampleRate;
+	maximumSamplesPerBlock = newMaximumSamplesPerBlock;
+	numChannels = newNumChannels;
+
+	regionBuffer.setSize(numChannels, maximumSamplesPerBlock);
+	factors.assign((size_t)maximumSamplesPerBlock, 0.f);
+
+	readers.clear();
+	liveCompressors.clear();
+
+	for (auto* region : getPlaybackRegions())
+	{
+		auto* source = region->getAudioModification()->getAudioSource();
+
+		if (readers.find(source) == readers.end())
+		{
+			std::unique_ptr<juce::AudioFormatReader> reader = std::make_unique<juce::ARAAudioSourceReader>(source);
+
+			// Real-time playback can't wait on the host's disk reads
+			if (alwaysNonRealtime == AlwaysNonRealtime::no)
+			{
+				const auto readAhead = juce::jmax(4 * maximumSamplesPerBlock, juce::roundToInt(2.0 * sampleRate));
+				reader = std::make_unique<juce::BufferingAudioReader>(reader.release(), owner.getReadAheadThread(), readAhead);
+			}
+
+			readers.emplace(source, std::move(reader));
+		}
+
+		auto compressor = std::make_unique<Dsp::Compressor>(juce::SharedResourcePointer<SharedResources>()->getFastMathTables());
+		compressor->setParameters(settings);
+		compressor->prepare(sampleRate, maximumSamplesPerBlock, numChannels);
+		liveCompressors.emplace(region, std::move(compressor));
+	}
+
+	refreshCurves();
+}
+
+void CompressorPlaybackRenderer::releaseResources()
+{
+	readers.clear();
+	liveCompressors.clear();
+}
+
+void CompressorPlaybackRenderer::refreshCurves()
+{
+	if (!settingsSource)
+		return;
+
+	const auto current = settingsSource();
+	std::map<const juce::ARAAudioSource*, const GainCurve*> available;
+	auto next = std::make_unique<CurveSet>();
+	next->settings = current;
+
+	for (auto* region : getPlaybackRegions())
+	{
+		auto* source = region->getAudioModification()->getAudioSource();
+
+		if (available.count(source) == 0)
+		{
+			auto curve = owner.getCurve(source, current);
+			available[source] = curve.get();
+
+			if (curve != nullptr)
+				next->curves.emplace(source, std::move(curve));
+		}
+	}
+
+	if (hasPublished && available == publishedCurves && GainCurve::hasSameDynamics(current, publishedSettings))
+		return;
+
+	publishedCurves = std::move(available);
+	publishedSettings = current;
+	hasPublished = true;
+	curveSets.publish(std::move(next));
+}
+
+bool CompressorPlaybackRenderer::processBlock(juce::AudioBuffer<float>& buffer, juce::AudioProcessor::Realtime,
+	const juce::AudioPlayHead::PositionInfo& positionInfo) noexcept
+{
+	const auto numSamples = buffer.getNumSamples();
+	jassert(numSamples <= maximumSamplesPerBlock && buffer.getNumChannels() == numChannels);
+
+	curveSets.acquireNew();
+	const auto* curveSet = curveSets.getCurrent();
+
+	buffer.clear();
+
+	if (!positionInfo.getIsPlaying())
+		return true;
+
+	const auto blockRange = juce::Range<juce::int64>::withStartAndLength(positionInfo.getTimeInSamples().orFallback(0), numSamples);
+	auto success = true;
+
+	for (const auto* region : getPlaybackRegions())
+	{
+		const auto playbackRange = region->getSampleRange(sampleRate, juce::ARAPlaybackRegion::IncludeHeadAndTail::no);
+		auto renderRange = blockRange.getIntersectionWith(playbackRange);
+
+		// No time stretching: song and source time only differ by an offset
+		const juce::Range<juce::int64> modificationRange{ region->getStartInAudioModificationSamples(), region->getEndInAudioModificationSamples() };
+		const auto sourceOffset = modificationRange.getStart() - playbackRange.getStart();
+		renderRange = renderRange.getIntersectionWith(modificationRange.movedToStartAt(playbackRange.getStart()));
+
+		if (renderRange.isEmpty())
+			continue;
+
+		const auto* source = region->getAudioModification()->getAudioSource();
+		const auto reader = readers.find(source);
+
+		// Sample rate and channel conversion are left to the host
+		if (reader == readers.end() || source->getSampleRate() != sampleRate || source->getChannelCount() != numChannels)
+		{
+			success = false;
+			continue;
+		}
+
+		const auto length = (int)renderRange.getLength();
+		const auto startInBuffer = (int)(renderRange.getStart() - blockRange.getStart());
+		const auto startInSource = renderRange.getStart() + sourceOffset;
+
+		if (!reader->second->read(regionBuffer.getArrayOfWritePointers(), numChannels, startInSource, length))
+		{
+			success = false;
+			continue;
+		}
+
+		const GainCurve* curve{};
+
+		if (curveSet != nullptr && GainCurve::hasSameDynamics(curveSet->settings, settings))
+		{
+			const auto found = curveSet->curves.find(source);
+
+			if (found != curveSet->curves.end() && found->second->covers(startInSource, length))
+				curve = found->second.get();
+		}
+
+		if (curve != nullptr)
+			applyCurve(regionBuffer, 0, length, startInSource, *curve);
+		else
+			applyLive(regionBuffer, 0, length, region);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+			buffer.addFrom(channel, startInBuffer, regionBuffer, channel, 0, length);
+	}
+
+	return success;
+}
+
+void CompressorPlaybackRenderer::applyCurve(juce::AudioBuffer<float>& target, int startInBuffer, int numSamples, juce::int64 startInSource, const GainCurve& curve) noexcept
+{
+	const auto mix = settings.mix;
+	const auto makeup = juce::Decibels::decibelsToGain(settings.gain);
+	const auto* gains = curve.gains.data();
+	constexpr auto stepScale = 1.f / (float)GainCurve::step;
+
+	for (int i = 0; i < numSamples; ++i)
+	{
+		const auto sample = startInSource + i;
+		const auto index = (size_t)(sample / GainCurve::step);
+		const auto fraction = (float)(sample - (juce::int64)index * GainCurve::step) * stepScale;
+		const auto gain = gains[index] + fraction * (gains[index + 1] - gains[index]);
+
+		factors[(size_t)i] = 1.f - mix + mix * makeup * gain;
+	}
+
+	for (int channel = 0; channel < numChannels; ++channel)
+		juce::FloatVectorOperations::multiply(target.getWritePointer(channel, startInBuffer), factors.data(), numSamples);
+}
+
+void CompressorPlaybackRenderer::applyLive(juce::AudioBuffer<float>& target, int startInBuffer, int numSamples, const juce::ARAPlaybackRegion* region) noexcept
+{
+	const auto found = liveCompressors.find(region);
+
+	if (found == liveCompressors.end())
+		return;
+
+	float* channels[Dsp::MeterBank::maxChannels];
+	const auto numToProcess = juce::jmin(numChannels, Dsp::MeterBank::maxChannels);
+
+	for (int channel = 0; channel < numToProcess; ++channel)
+		channels[channel] = target.getWritePointer(channel, startInBuffer);
+
+	found->second->setParameters(settings);
+	found->second->process(channels, numToProcess, numSamples);
+}
+
+//==============================================================================
+const ARA::ARAFactory* JUCE_CALLTYPE createARAFactory()
+{
+	return juce::ARADocumentControllerSpecialisation::createARAFactory<CompressorDocumentController>();
+}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+	ARA support: clip-based playback from precomputed gain curves.
+
+	In an ARA host the compressor works on each audio source (clip) as a
+	whole. The document controller analyses a source once, on a low
+	priority pool with one job per source so clips are analysed in
+	parallel, and keeps the gain reduction it produces as a linear curve
+	with one point every GainCurve::step samples. Playback reads the
+	source, interpolates the curve and multiplies; makeup and mix are
+	applied live, so only threshold, knee, ratio, attack and release are
+	part of a curve's key.
+
+	Curves are dropped per source when its samples change, and a change of
+	the dynamics settings simply asks for a different curve. Until the
+	right one is ready the renderer runs a live Dsp::Compressor per
+	playback region instead.
+
+	The audio thread gets the curves through a Dsp::SnapshotExchange, which
+	the message thread refreshes from a timer.
+
+	Only built with JucePlugin_Enable_ARA, which needs the ARA SDK set up
+	in the Projucer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JucePlugin_Enable_ARA
+
+#include <functional>
+#include <map>
+
+#include "Dsp/ChainSettings.h"
+#include "Dsp/Compressor.h"
+#include "Dsp/SnapshotExchange.h"
+
+struct GainCurve
+{
+	static constexpr int step{ 32 };
+
+	ChainSettings settings;
+
+	// Gain reduction as a linear factor at every step-th source sample, from sample 0
+	std::vector<float> gains;
+
+	std::atomic<bool> ready{}, cancelled{};
+
+	static bool hasSameDynamics(const ChainSettings& a, const ChainSettings& b) noexcept
+	{
+		return a.threshold == b.threshold && a.knee == b.knee && a.ratio == b.ratio && a.attack == b.attack && a.release == b.release;
+	}
+
+	bool covers(juce::int64 sourceSample, int numSamples) const noexcept
+	{
+		return sourceSample >= 0 && (sourceSample + numSamples) / step + 1 < (juce::int64)gains.size();
+	}
+};
+
+class CompressorDocumentController;
+
+class CompressorPlaybackRenderer : public juce::ARAPlaybackRenderer
+{
+public:
+	CompressorPlaybackRenderer(ARA::PlugIn::DocumentController* documentController, CompressorDocumentController& owner);
+	~CompressorPlaybackRenderer() override;
+
+	void prepareToPlay(double sampleRate, int maximumSamplesPerBlock, int numChannels,
+		juce::AudioProcessor::ProcessingPrecision precision, AlwaysNonRealtime alwaysNonRealtime) override;
+	void releaseResources() override;
+
+	bool processBlock(juce::AudioBuffer<float>& buffer, juce::AudioProcessor::Realtime realtime,
+		const juce::AudioPlayHead::PositionInfo& positionInfo) noexcept override;
+
+	// Audio thread, before each processBlock: the settings the bound processor is using
+	void setChainSettings(const ChainSettings& newSettings) noexcept { settings = newSettings; }
+
+	// Message thread: where the curves' settings come from, cleared before the processor goes away
+	void setSettingsSource(std::function<ChainSettings()> source) { settingsSource = std::move(source); }
+
+	// Message thread: publishes the ready curves for the current settings if they changed
+	void refreshCurves();
+
+private:
+	struct CurveSet
+	{
+		ChainSettings settings;
+		std::map<const juce::ARAAudioSource*, std::shared_ptr<const GainCurve>> curves;
+	};
+
+	void applyCurve(juce::AudioBuffer<float>& buffer, int startInBuffer, int numSamples, juce::int64 startInSource, const GainCurve& curve) noexcept;
+	void applyLive(juce::AudioBuffer<float>& buffer, int startInBuffer, int numSamples, const juce::ARAPlaybackRegion* region) noexcept;
+
+	CompressorDocumentController& owner;
+	std::function<ChainSettings()> settingsSource;
+
+	Dsp::SnapshotExchange<CurveSet> curveSets;
+	// What was last published, message thread only
+	std::map<const juce::ARAAudioSource*, const GainCurve*> publishedCurves;
+	ChainSettings publishedSettings;
+	bool hasPublished{};
+
+	ChainSettings settings;
+	double sampleRate{ 44100.0 };
+	int numChannels{ 2 }, maximumSamplesPerBlock{};
+
+	std::map<const juce::ARAAudioSource*, std::unique_ptr<juce::AudioFormatReader>> readers;
+	std::map<const juce::ARAPlaybackRegion*, std::unique_ptr<Dsp::Compressor>> liveCompressors;
+	juce::AudioBuffer<float> regionBuffer;
+	std::vector<float> factors;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompressorPlaybackRenderer)
+};
+
+class CompressorDocumentController : public juce::ARADocumentControllerSpecialisation,
+	private juce::ARAAudioSource::Listener,
+	private juce::Timer
+{
+public:
+	CompressorDocumentController(const ARA::PlugIn::PlugInEntry* entry, const ARA::ARADocumentControllerHostInstance* instance);
+	~CompressorDocumentController() override;
+
+	// Message thread: the ready curve for this source and these dynamics, or nullptr after
+	// making sure one is being analysed
+	std::shared_ptr<const GainCurve> getCurve(juce::ARAAudioSource* source, const ChainSettings& settings);
+
+	void addRenderer(CompressorPlaybackRenderer* renderer) { renderers.push_back(renderer); }
+	void removeRenderer(CompressorPlaybackRenderer* renderer) { renderers.erase(std::remove(renderers.begin(), renderers.end(), renderer), renderers.end()); }
+
+	// Buffers the renderers' reads during real-time playback
+	juce::TimeSliceThread& getReadAheadThread() noexcept { return readAheadThread; }
+
+protected:
+	juce::ARAPlaybackRenderer* doCreatePlaybackRenderer() noexcept override;
+	juce::ARAAudioSource* doCreateAudioSource(juce::ARADocument* document, ARA::ARAAudioSourceHostRef hostRef) noexcept override;
+
+	// Curves are cheap to rebuild, so nothing goes into the document archive
+	bool doRestoreObjectsFromStream(juce::ARAInputStream&, const juce::ARARestoreObjectsFilter*) noexcept override { return true; }
+	bool doStoreObjectsToStream(juce::ARAOutputStream&, const juce::ARAStoreObjectsFilter*) noexcept override { return true; }
+
+private:
+	class AnalysisJob;
+
+	struct Entry
+	{
+		juce::ARAAudioSource* source{};
+		std::shared_ptr<GainCurve> curve;
+	};
+
+	void didUpdateAudioSourceContent(juce::ARAAudioSource* source, juce::ARAContentUpdateScopes scopeFlags) override;
+	void willDestroyAudioSource(juce::ARAAudioSource* source) override;
+	void timerCallback() override;
+
+	void invalidate(juce::ARAAudioSource* source);
+
+	// Curves kept per source, counting the ones still being analysed; the oldest go first
+	static constexpr int maxCurvesPerSource{ 4 };
+
+	std::vector<Entry> entries;
+	std::vector<CompressorPlaybackRenderer*> renderers;
+	juce::TimeSliceThread readAheadThread{ "ARA read-ahead" };
+	juce::ThreadPool pool{ juce::jmax(1, juce::SystemStats::getNumCpus() - 1), 0, juce::Thread::Priority::low };
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompressorDocumentController)
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+	Compact binary plugin state.
+
+  ==============================================================================
+*/
+
+#include "CompactState.h"
+
+namespace CompactState
+{
+	bool isCompactState(const void* data, int sizeInBytes) noexcept
+	{
+		return data != nullptr && sizeInBytes >= headerSize && juce::ByteOrder::littleEndianInt(data) == magic;
+	}
+
+	void write(juce::MemoryBlock& destData, const float* values, int numValues, std::initializer_list<Record> records)
+	{
+		juce::MemoryOutputStream stream(destData, false);
+
+		stream.writeInt((int)magic);
+		stream.writeShort((short)currentVersion);
+		stream.writeShort((short)headerSize);
+		stream.writeShort((short)numValues);
+		stream.writeShort(0);
+
+		for (int i = 0; i < numValues; ++i)
+			stream.writeFloat(values[i]);
+
+		for (const auto& record : records)
+		{
+			stream.writeInt((int)record.tag);
+			stream.writeInt(record.size);
+			stream.write(record.data, (size_t)record.size);
+		}
+	}
+
+	int read(const void* data, int sizeInBytes, float* values, int maxValues) noexcept
+	{
+		if (!isCompactState(data, sizeInBytes))
+			return -1;
+
+		const auto* bytes = static_cast<const char*>(data);
+		const auto valuesStart = (int)juce::ByteOrder::littleEndianShort(bytes + 6);
+		const auto numValues = (int)juce::ByteOrder::littleEndianShort(bytes + 8);
+		const auto valuesEnd = valuesStart + numValues * (int)sizeof(float);
+
+		if (valuesStart < headerSize || valuesEnd > sizeInBytes)
+			return -1;
+
+		// The extension area must at least be made of whole records
+		for (auto position = valuesEnd; position < sizeInBytes;)
+		{
+			if (sizeInBytes - position < 8)
+				return -1;
+
+			const auto payloadSize = (juce::int64)juce::ByteOrder::littleEndianInt(bytes + position + 4);
+
+			if (payloadSize > sizeInBytes - position - 8)
+				return -1;
+
+			position += 8 + (int)payloadSize;
+		}
+
+		const auto numToRead = juce::jmin(numValues, maxValues);
+
+		for (int i = 0; i < numToRead; ++i)
+		{
+			const auto bits = juce::ByteOrder::littleEndianInt(bytes + valuesStart + i * (int)sizeof(float));
+			std::memcpy(values + i, &bits, sizeof(float));
+		}
+
+		return numValues;
+	}
+
+	Record findRecord(const void* data, int sizeInBytes, juce::uint32 tag) noexcept
+	{
+		const auto* bytes = static_cast<const char*>(data);
+		const auto valuesStart = (int)juce::ByteOrder::littleEndianShort(bytes + 6);
+		const auto numValues = (int)juce::ByteOrder::littleEndianShort(bytes + 8);
+
+		for (auto position = valuesStart + numValues * (int)sizeof(float); position + 8 <= sizeInBytes;)
+		{
+			const auto payloadSize = (int)juce::ByteOrder::littleEndianInt(bytes + position + 4);
+
+			if (juce::ByteOrder::littleEndianInt(bytes + position) == tag)
+				return { tag, bytes + position + 8, payloadSize };
+
+			position += 8 + payloadSize;
+		}
+
+		return {};
+	}
+}
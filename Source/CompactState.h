@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+	Compact binary plugin state.
+
+	All fields are little-endian:
+
+		uint32  magic "C2ST"
+		uint16  version
+		uint16  header size in bytes, values start here
+		uint16  number of values
+		uint16  flags, zero for now
+		float32 plain parameter values, in CompressorV2AudioProcessor's
+		        state order
+		        extension area up to the end of the data: records of
+		        uint32 tag, uint32 payload size, payload
+
+	Parameters are only ever appended to the state order, so an older state
+	simply has fewer values and the rest keep their defaults. Readers skip
+	extension records they don't know. Reading never allocates.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace CompactState
+{
+	constexpr juce::uint32 magic{ 0x54533243 };   // "C2ST"
+	constexpr juce::uint16 currentVersion{ 1 };
+	constexpr int headerSize{ 12 };
+
+	// An extension record, tagged with four characters read as a little-endian uint32
+	struct Record
+	{
+		juce::uint32 tag{};
+		const void* data{};
+		int size{};
+	};
+
+	constexpr juce::uint32 makeTag(const char (&name)[5]) noexcept
+	{
+		return (juce::uint32)(juce::uint8)name[0] | (juce::uint32)(juce::uint8)name[1] << 8
+			| (juce::uint32)(juce::uint8)name[2] << 16 | (juce::uint32)(juce::uint8)name[3] << 24;
+	}
+
+	bool isCompactState(const void* data, int sizeInBytes) noexcept;
+
+	void write(juce::MemoryBlock& destData, const float* values, int numValues, std::initializer_list<Record> records = {});
+
+	// Fills values with up to maxValues entries and returns how many there were,
+	// or -1 if the data isn't a well-formed compact state
+	int read(const void* data, int sizeInBytes, float* values, int maxValues) noexcept;
+
+	// The first record with this tag, pointing into data, or an empty one.
+	// Only call it on data read() has accepted.
+	Record findRecord(const void* data, int sizeInBytes, juce::uint32 tag) noexcept;
+}
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+	Steps processing quality down when blocks overrun their share of the
+	real-time deadline, and back up once there is headroom again, JUCE-free.
+
+	The audio thread reports each block's length and how long it took. One
+	block over budgetFraction of its deadline is enough to drop a level, so
+	a spike costs quality rather than a dropout; further drops wait
+	minimumStepSeconds to see the effect of the last one. Stepping back up
+	needs the smoothed load under recoverFraction for recoverSeconds, and
+	every drop restarts that wait, so a machine near the limit settles on a
+	level instead of oscillating.
+
+	Level 0 is the caller's own choice and each level above it one step
+	coarser; what the steps mean is up to the caller, which can shrink the
+	range when its choice leaves fewer steps to take. The level and the
+	count of downgrades can be read from any thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace Dsp
+{
+	class AdaptiveQuality
+	{
+	public:
+		struct Options
+		{
+			double budgetFraction{ 0.5 };
+			double recoverFraction{ 0.2 };
+			double recoverSeconds{ 2.0 };
+			double minimumStepSeconds{ 0.05 };
+		};
+
+		AdaptiveQuality(int numberOfLevels, Options newOptions)
+			: numLevels(std::max(1, numberOfLevels)), options(newOptions)
+		{
+		}
+
+		explicit AdaptiveQuality(int numberOfLevels) : AdaptiveQuality(numberOfLevels, Options()) {}
+
+		void prepare(double newSampleRate) noexcept
+		{
+			sampleRate = newSampleRate;
+			reset();
+		}
+
+		// Back to full quality; the downgrade count is kept
+		void reset() noexcept
+		{
+			level.store(0, std::memory_order_relaxed);
+			smoothedLoad = 0.0;
+			secondsSinceStep = secondsCalm = 0.0;
+		}
+
+		// Audio thread: how many levels there are from the caller's choice down, itself included;
+		// a level past the new range is pulled back to its end
+		void setNumLevels(int newNumLevels) noexcept
+		{
+			numLevels = std::max(1, newNumLevels);
+
+			if (getLevel() >= numLevels)
+				setLevel(numLevels - 1);
+		}
+
+		// Audio thread: returns the level for the next block
+		int update(int numSamples, double elapsedSeconds) noexcept
+		{
+			if (numSamples <= 0 || sampleRate <= 0.0)
+				return getLevel();
+
+			const auto blockSeconds = numSamples / sampleRate;
+			const auto load = elapsedSeconds / blockSeconds;
+			auto current = getLevel();
+
+			// Roughly a 100 ms average, whatever the block size
+			const auto smoothing = std::min(1.0, blockSeconds / 0.1);
+			smoothedLoad += smoothing * (load - smoothedLoad);
+			secondsSinceStep += blockSeconds;
+			secondsCalm = smoothedLoad < options.recoverFraction ? secondsCalm + blockSeconds : 0.0;
+
+			if (load > options.budgetFraction && current + 1 < numLevels && secondsSinceStep >= options.minimumStepSeconds)
+			{
+				setLevel(++current);
+				downgrades.store(downgrades.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+			else if (load > options.budgetFraction)
+			{
+				secondsCalm = 0.0;
+			}
+			else if (current > 0 && secondsCalm >= options.recoverSeconds)
+			{
+				setLevel(--current);
+			}
+
+			return current;
+		}
+
+		int getLevel() const noexcept { return level.load(std::memory_order_relaxed); }
+		int getNumLevels() const noexcept { return numLevels; }
+		std::uint64_t getDowngrades() const noexcept { return downgrades.load(std::memory_order_relaxed); }
+
+	private:
+		void setLevel(int newLevel) noexcept
+		{
+			level.store(newLevel, std::memory_order_relaxed);
+			secondsSinceStep = secondsCalm = 0.0;
+		}
+
+		int numLevels;
+		const Options options;
+		double sampleRate{};
+
+		double smoothedLoad{}, secondsSinceStep{}, secondsCalm{};
+		std::atomic<int> level{};
+		std::atomic<std::uint64_t> downgrades{};
+	};
+}
@@ -0,0 +1,25 @@
+/*
+  ==============================================================================
+
+	Plain parameter snapshot shared by the plugin and the DSP core.
+
+	threshold, knee and gain are in dB, attack and release in ms,
+	ratio is n:1 and mix runs from 0 (dry) to 1 (wet).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+struct ChainSettings
+{
+	float threshold{}, knee{}, ratio{ 1.f }, attack{ 20.f }, release{ 20.f }, gain{}, mix{ 1.f };
+
+	bool operator==(const ChainSettings& other) const noexcept
+	{
+		return threshold == other.threshold && knee == other.knee && ratio == other.ratio && attack == other.attack
+			&& release == other.release && gain == other.gain && mix == other.mix;
+	}
+
+	bool operator!=(const ChainSettings& other) const noexcept { return !(*this == other); }
+};
@@ -0,0 +1,830 @@
+/*
+  ==============================================================================
+
+	JUCE-free compressor core: detector, gain computer, envelope and mix.
+
+  ==============================================================================
+*/
+
+#include "Compressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace Dsp
+{
+	namespace
+	{
+		constexpr int maxChannels{ 64 };
+
+		float getSmoothingCoefficient(float timeMs, double sampleRate) noexcept
+		{
+			const auto samples = (double)timeMs * 0.001 * sampleRate;
+			return samples > 0.0 ? (float)(1.0 - std::exp(-1.0 / samples)) : 1.f;
+		}
+
+		float interpolate(float from, float to, float amount) noexcept
+		{
+			return from + amount * (to - from);
+		}
+
+		ChainSettings interpolate(const ChainSettings& from, const ChainSettings& to, float amount) noexcept
+		{
+			ChainSettings result;
+			result.threshold = interpolate(from.threshold, to.threshold, amount);
+			result.knee = interpolate(from.knee, to.knee, amount);
+			result.ratio = 1.f / interpolate(1.f / from.ratio, 1.f / to.ratio, amount);
+			result.attack = interpolate(from.attack, to.attack, amount);
+			result.release = interpolate(from.release, to.release, amount);
+			result.gain = interpolate(from.gain, to.gain, amount);
+			result.mix = interpolate(from.mix, to.mix, amount);
+			return result;
+		}
+
+		// Inf and NaN have every exponent bit set. As a test on the bits the masking passes
+		// vectorise to a compare and a select rather than a branch per sample.
+		bool isNonFinite(float level) noexcept
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &level, sizeof(bits));
+			return (bits & 0x7f800000u) == 0x7f800000u;
+		}
+
+		// Judged as float levels, the way the detector sees them, so a double too large for one goes too.
+		// Returns the number of samples replaced.
+		template <typename SampleType>
+		int zeroNonFinite(SampleType* data, int numSamples) noexcept
+		{
+			auto count = 0;
+
+			for (int i = 0; i < numSamples; ++i)
+			{
+				const auto bad = isNonFinite((float)std::abs(data[i]));
+				data[i] = bad ? SampleType(0) : data[i];
+				count += (int)bad;
+			}
+
+			return count;
+		}
+
+		template <typename SampleType>
+		bool isAllZero(const SampleType* data, int numSamples) noexcept
+		{
+			std::uint32_t nonZero{};
+
+			for (int i = 0; i < numSamples; ++i)
+				nonZero |= (std::uint32_t)(data[i] != SampleType(0));
+
+			return nonZero == 0;
+		}
+	}
+
+	Compressor::Compressor(std::shared_ptr<const FastMathTables> sharedTables)
+		: tables(sharedTables != nullptr ? std::move(sharedTables) : std::make_shared<const FastMathTables>())
+	{
+		applySettings(settings);
+		morphTarget = settings;
+	}
+
+	void Compressor::prepare(double newSampleRate, int newMaximumBlockSize, int /*numChannels*/)
+	{
+		sampleRate = newSampleRate;
+		maximumBlockSize = std::max(newMaximumBlockSize, 1);
+
+		levels.assign((size_t)maximumBlockSize, 0.f);
+		gains.assign((size_t)maximumBlockSize, 0.f);
+		offsets.assign((size_t)maximumBlockSize, 0.f);
+		heardCells.assign((size_t)(maximumBlockSize / gridLength + 2), 0);
+
+		makeupCellDecay = (float)std::exp(-gridLength / (makeupSmoothingSeconds * sampleRate));
+		runningMakeupAmount = (float)(1.0 - std::exp(-gridLength / (runningMakeupSeconds * sampleRate)));
+
+		// A morph in flight when playback restarts has nothing left to smooth
+		applySettings(morphTarget);
+		morphPosition = morphLength = 0;
+		reset();
+	}
+
+	size_t Compressor::getHeapSizeInBytes() const noexcept
+	{
+		return (levels.capacity() + gains.capacity() + offsets.capacity()) * sizeof(float) + heardCells.capacity();
+	}
+
+	void Compressor::reset() noexcept
+	{
+		envelope = 0.f;
+		gridPhase = 0;
+
+		// Nothing measured yet; the curve's makeup is known straight away
+		runningReduction = 0.f;
+		makeupDb = makeupNext = getMakeupTarget();
+		makeupMoving = cellHeard = false;
+
+		controlPeak = 0.f;
+		controlFrom = controlTarget = getFactor(0.f, settings.gain + makeupDb);
+		handoverLength = handoverDone = 0;
+	}
+
+	void Compressor::setAutoMakeup(AutoMakeup newMode) noexcept
+	{
+		if (newMode == autoMakeup)
+			return;
+
+		// Start the average from what is applied now, so switching doesn't jump
+		if (newMode == AutoMakeup::running)
+			runningReduction = -getMakeupDecibels();
+
+		autoMakeup = newMode;
+
+		if (maximumBlockSize == 0)
+			makeupDb = makeupNext = getMakeupTarget();
+	}
+
+	float Compressor::getMakeupTarget() const noexcept
+	{
+		const auto limit = FastMathTables::maxDecibels - settings.gain;
+
+		switch (autoMakeup)
+		{
+		case AutoMakeup::curve:   return std::min(curveMakeup, limit);
+		case AutoMakeup::running: return std::min(-runningReduction, limit);
+		case AutoMakeup::off:     break;
+		}
+
+		return 0.f;
+	}
+
+	bool Compressor::isMakeupSettled() const noexcept
+	{
+		return autoMakeup != AutoMakeup::running && makeupDb == makeupNext && makeupNext == getMakeupTarget();
+	}
+
+	void Compressor::advanceMakeup(int numSamples, const float* envelopeDb) noexcept
+	{
+		// Nothing can move it before the sub-block ends, so only the grid moves on
+		makeupMoving = !isMakeupSettled();
+
+		if (!makeupMoving)
+		{
+			gridPhase = (gridPhase + numSamples) % gridLength;
+			return;
+		}
+
+		for (int start = 0, cell = 0; start < numSamples; ++cell)
+		{
+			const auto length = std::min(gridLength - gridPhase, numSamples - start);
+			const auto step = (makeupNext - makeupDb) / (float)gridLength;
+
+			for (int i = 0; i < length; ++i)
+				offsets[(size_t)(start + i)] = makeupDb + step * (float)(gridPhase + i + 1);
+
+			cellHeard = cellHeard || heardCells[(size_t)cell] != 0;
+			start += length;
+			gridPhase += length;
+
+			if (gridPhase == gridLength)
+			{
+				gridPhase = 0;
+				finishGridCell(envelopeDb != nullptr ? envelopeDb[start - 1] : getDecayedEnvelope(envelope, start));
+			}
+		}
+	}
+
+	void Compressor::finishGridCell(float envelopeDb) noexcept
+	{
+		// Silence says nothing about how hard the material is compressed
+		if (autoMakeup == AutoMakeup::running && cellHeard)
+			runningReduction += runningMakeupAmount * (envelopeDb - runningReduction);
+
+		cellHeard = false;
+		makeupDb = makeupNext;
+
+		const auto target = getMakeupTarget();
+		makeupNext = target + (makeupDb - target) * makeupCellDecay;
+
+		if (std::abs(makeupNext - target) < 1.0e-4f)
+			makeupNext = target;
+	}
+
+	void Compressor::markHeardCells(int numSamples, float blockPeak) noexcept
+	{
+		for (int start = 0, cell = 0, phase = gridPhase; start < numSamples; ++cell, phase = 0)
+		{
+			const auto length = std::min(gridLength - phase, numSamples - start);
+			auto peak = 0.f;
+
+			if (blockPeak > 0.f)
+				for (int i = start; i < start + length; ++i)
+					peak = std::max(peak, levels[(size_t)i]);
+
+			heardCells[(size_t)cell] = peak > 0.f;
+			start += length;
+		}
+	}
+
+	void Compressor::setParameters(const ChainSettings& newSettings) noexcept
+	{
+		if (newSettings == morphTarget)
+			return;
+
+		morphTarget = newSettings;
+		const auto length = maximumBlockSize > 0 ? (int)std::lround((double)morphTimeMs * 0.001 * sampleRate) : 0;
+
+		if (length <= 0)
+		{
+			applySettings(newSettings);
+			morphPosition = morphLength = 0;
+			return;
+		}
+
+		// Retargeting mid-morph starts again from wherever the last one got to
+		morphStart = settings;
+		morphLength = length;
+		morphPosition = 0;
+	}
+
+	void Compressor::applySettings(const ChainSettings& newSettings) noexcept
+	{
+		settings = newSettings;
+		gainComputer.setParameters(settings.threshold, settings.knee, settings.ratio);
+		quietLevel = (float)std::pow(10.0, ((double)gainComputer.threshold - (double)gainComputer.kneeHalf) / 20.0);
+		curveMakeup = -gainComputer.getGainDecibels(0.f);
+		updateCoefficients();
+	}
+
+	void Compressor::advanceMorph(int numSamples) noexcept
+	{
+		// Lands on the values for the end of the grid cell, so a cell split between two blocks gets one set
+		// of settings and the last cell reaches the target exactly
+		const auto cellEnd = std::min(morphPosition + gridLength - gridPhase, morphLength);
+		morphPosition = std::min(morphPosition + numSamples, morphLength);
+
+		if (cellEnd == morphLength)
+			applySettings(morphTarget);
+		else
+			applySettings(interpolate(morphStart, morphTarget, (float)cellEnd / (float)morphLength));
+	}
+
+	void Compressor::updateCoefficients() noexcept
+	{
+		attackCoefficient = getSmoothingCoefficient(settings.attack, sampleRate);
+		releaseCoefficient = getSmoothingCoefficient(settings.release, sampleRate);
+
+		// n one-pole steps towards a fixed target in one: 1 - (1 - c)^n
+		controlAttackCoefficient = getSmoothingCoefficient(settings.attack, sampleRate / controlInterval);
+		controlReleaseCoefficient = getSmoothingCoefficient(settings.release, sampleRate / controlInterval);
+	}
+
+	void Compressor::setControlInterval(int samples) noexcept
+	{
+		samples = std::clamp(samples, 1, maxControlInterval);
+
+		// Powers of two divide the grid, so every interval ends on the same samples whatever the blocks
+		while ((samples & (samples - 1)) != 0)
+			samples &= samples - 1;
+
+		if (samples == controlInterval)
+			return;
+
+		// The old ramp lags the envelope by up to its interval, more than the new one can make up
+		// in a sample, so it plays on and fades out across one old interval
+		if (samples < controlInterval)
+		{
+			handoverFrom = controlFrom;
+			handoverStep = (controlTarget - controlFrom) / (float)controlInterval;
+			handoverInterval = controlInterval;
+			handoverPosition = gridPhase % controlInterval;
+			handoverLength = controlInterval;
+			handoverDone = 0;
+		}
+
+		if (controlInterval == 1)
+		{
+			// From the full rate: hold what the envelope gives now until the first point
+			controlFrom = controlTarget = getFactor(envelope, settings.gain + getMakeupDecibels());
+			controlPeak = 0.f;
+		}
+		else
+		{
+			// Between intervals: the same target, reached from where the ramp is now over what is left of the new one
+			const auto oldPhase = (float)(gridPhase % controlInterval) / (float)controlInterval;
+			const auto newPhase = (float)(gridPhase % samples) / (float)samples;
+			const auto current = controlFrom + (controlTarget - controlFrom) * oldPhase;
+			controlFrom = (current - controlTarget * newPhase) / (1.f - newPhase);
+		}
+
+		controlInterval = samples;
+
+		for (int i = 0; i < controlInterval; ++i)
+			controlRamp[(size_t)i] = (float)(i + 1) / (float)controlInterval;
+
+		updateCoefficients();
+	}
+
+	PathCounts Compressor::getPathCounts() const noexcept
+	{
+		return { countSinceReset(silentBlocks, silentBlocksAtReset), countSinceReset(belowThresholdBlocks, belowThresholdBlocksAtReset),
+			countSinceReset(fullBlocks, fullBlocksAtReset) };
+	}
+
+	void Compressor::resetPathCounts() noexcept
+	{
+		markReset(silentBlocks, silentBlocksAtReset);
+		markReset(belowThresholdBlocks, belowThresholdBlocksAtReset);
+		markReset(fullBlocks, fullBlocksAtReset);
+	}
+
+	FaultCounts Compressor::getFaultCounts() const noexcept
+	{
+		return { countSinceReset(nonFiniteSamples, nonFiniteSamplesAtReset), countSinceReset(stateResets, stateResetsAtReset) };
+	}
+
+	void Compressor::resetFaultCounts() noexcept
+	{
+		markReset(nonFiniteSamples, nonFiniteSamplesAtReset);
+		markReset(stateResets, stateResetsAtReset);
+	}
+
+	void Compressor::increment(std::atomic<std::uint64_t>& counter, std::uint64_t amount) noexcept
+	{
+		// Only the audio thread writes, so this needn't be a read-modify-write
+		counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	std::uint64_t Compressor::countSinceReset(const std::atomic<std::uint64_t>& counter, const std::atomic<std::uint64_t>& atReset) noexcept
+	{
+		// Counts only grow, so one read after a concurrent reset can at worst see the snapshot ahead of its count
+		auto count = counter.load(std::memory_order_relaxed);
+		auto base = atReset.load(std::memory_order_relaxed);
+		return count > base ? count - base : 0;
+	}
+
+	void Compressor::markReset(const std::atomic<std::uint64_t>& counter, std::atomic<std::uint64_t>& atReset) noexcept
+	{
+		atReset.store(counter.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	int Compressor::getWarmUpSamples(float toleranceDb) const noexcept
+	{
+		// Both branches of the envelope shrink the distance between two states by at least
+		// (1 - c) per sample, starting from at most the full range of the dB tables
+		auto slowest = (double)std::min(attackCoefficient, releaseCoefficient);
+
+		// The running makeup holds through silence, so it can carry the envelope's history any distance
+		if (autoMakeup == AutoMakeup::running)
+			return std::numeric_limits<int>::max();
+
+		const auto initialDistance = (double)(FastMathTables::maxDecibels - FastMathTables::minDecibels);
+
+		if (slowest >= 1.0 || toleranceDb >= initialDistance)
+			return 0;
+
+		if (slowest <= 0.0)
+			return std::numeric_limits<int>::max();
+
+		// The eco gain ramps towards the envelope one interval behind it
+		const auto lag = controlInterval > 1 ? controlInterval : 0;
+		const auto samples = std::log((double)toleranceDb / initialDistance) / std::log1p(-slowest) + lag;
+		return (int)std::min(std::ceil(samples), (double)std::numeric_limits<int>::max());
+	}
+
+	template <typename SampleType>
+	void Compressor::process(SampleType* const* channels, int numChannels, int numSamples) noexcept
+	{
+		if (maximumBlockSize == 0)
+			return;
+
+		numChannels = std::min(numChannels, maxChannels);
+		meters.setNumChannels(std::min(numChannels, MeterBank::maxChannels));
+
+		SampleType* blockChannels[maxChannels];
+
+		for (int offset = 0; offset < numSamples;)
+		{
+			auto blockSize = std::min(maximumBlockSize, numSamples - offset);
+
+			if (isMorphing())
+			{
+				blockSize = std::min(blockSize, gridLength - gridPhase);
+				advanceMorph(blockSize);
+			}
+
+			for (int channel = 0; channel < numChannels; ++channel)
+				blockChannels[channel] = channels[channel] + offset;
+
+			float blockPeak;
+			int numQuiet = 0;
+
+			{
+				StageProfiler::ScopedTimer timer(profiler, Stage::detector, blockSize);
+				blockPeak = detectPeaks(blockChannels, numChannels, blockSize);
+
+				if (autoMakeup == AutoMakeup::running)
+					markHeardCells(blockSize, blockPeak);
+
+				if (controlInterval == 1)
+				{
+					if (blockPeak <= quietLevel)
+						numQuiet = blockSize;
+					else
+						while (levels[(size_t)numQuiet] <= quietLevel)
+							++numQuiet;
+
+					convertLevelsToDecibels(numQuiet, blockSize);
+				}
+			}
+
+			if (controlInterval > 1)
+			{
+				increment(blockPeak == 0.f ? silentBlocks : blockPeak <= quietLevel ? belowThresholdBlocks : fullBlocks);
+				float minGainDb;
+
+				{
+					StageProfiler::ScopedTimer timer(profiler, Stage::gainComputer, blockSize);
+					minGainDb = computeControlRateGains(blockSize);
+				}
+
+				StageProfiler::ScopedTimer timer(profiler, Stage::mix, blockSize);
+				applyFactors(blockChannels, numChannels, blockSize, minGainDb);
+			}
+			else if (blockPeak == 0.f)
+			{
+				// Silence stays silence whatever the gain, so only the envelope, the makeup and the meters move on
+				increment(silentBlocks);
+				advanceMakeup(blockSize, nullptr);
+				const auto minGainDb = decayEnvelope(blockSize, false);
+
+				// Only zeros have a level of 0, or NaN, which the detector passes over
+				for (int channel = 0; channel < numChannels; ++channel)
+					if (!isAllZero(blockChannels[channel], blockSize))
+						increment(nonFiniteSamples, (std::uint64_t)zeroNonFinite(blockChannels[channel], blockSize));
+
+				StageProfiler::ScopedTimer timer(profiler, Stage::mix, blockSize);
+				addSilenceToMeters(numChannels, blockSize, minGainDb);
+			}
+			else if (numQuiet == blockSize && envelope == 0.f && isMakeupSettled())
+			{
+				// Settled below the knee: one gain for the whole block
+				increment(belowThresholdBlocks);
+				advanceMakeup(blockSize, nullptr);
+
+				StageProfiler::ScopedTimer timer(profiler, Stage::mix, blockSize);
+				std::fill(gains.begin(), gains.begin() + blockSize, getFactor(0.f, getGainOffset(0)));
+				applyFactors(blockChannels, numChannels, blockSize, 0.f);
+			}
+			else
+			{
+				increment(numQuiet == blockSize ? belowThresholdBlocks : fullBlocks);
+				float minGainDb;
+
+				{
+					StageProfiler::ScopedTimer timer(profiler, Stage::gainComputer, blockSize);
+					minGainDb = decayEnvelope(numQuiet, true);
+
+					if (numQuiet < blockSize)
+					{
+						computeGainBetween(numQuiet, blockSize);
+						minGainDb = std::min(minGainDb, smoothEnvelopeBetween(numQuiet, blockSize));
+					}
+
+					advanceMakeup(blockSize, gains.data());
+				}
+
+				StageProfiler::ScopedTimer timer(profiler, Stage::mix, blockSize);
+				applyGain(blockChannels, numChannels, blockSize, minGainDb);
+			}
+
+			handoverDone = std::min(handoverDone + blockSize, handoverLength);
+			guardState();
+			offset += blockSize;
+		}
+	}
+
+	template <typename SampleType>
+	void Compressor::track(const SampleType* const* channels, int numChannels, int numSamples) noexcept
+	{
+		if (maximumBlockSize == 0)
+			return;
+
+		numChannels = std::min(numChannels, maxChannels);
+		const SampleType* blockChannels[maxChannels];
+
+		for (int offset = 0; offset < numSamples;)
+		{
+			auto blockSize = std::min(maximumBlockSize, numSamples - offset);
+
+			if (isMorphing())
+			{
+				blockSize = std::min(blockSize, gridLength - gridPhase);
+				advanceMorph(blockSize);
+			}
+
+			for (int channel = 0; channel < numChannels; ++channel)
+				blockChannels[channel] = channels[channel] + offset;
+
+			const auto blockPeak = detectPeaks(blockChannels, numChannels, blockSize);
+
+			if (autoMakeup == AutoMakeup::running)
+				markHeardCells(blockSize, blockPeak);
+
+			if (controlInterval > 1)
+			{
+				computeControlRateGains(blockSize);
+			}
+			else if (blockPeak <= quietLevel)
+			{
+				// Whatever can't reach the knee releases towards 0 dB, so a quiet block is one decay
+				advanceMakeup(blockSize, nullptr);
+				decayEnvelope(blockSize, false);
+			}
+			else
+			{
+				convertLevelsToDecibels(0, blockSize);
+				computeGainBetween(0, blockSize);
+				smoothEnvelopeBetween(0, blockSize);
+				advanceMakeup(blockSize, gains.data());
+			}
+
+			handoverDone = std::min(handoverDone + blockSize, handoverLength);
+			guardState();
+			offset += blockSize;
+		}
+	}
+
+	void Compressor::guardState() noexcept
+	{
+		// The detector keeps NaN and Inf out, so this is for anything else that might get them in
+		if (std::isfinite(envelope) && std::isfinite(runningReduction) && std::isfinite(makeupDb) && std::isfinite(makeupNext)
+			&& std::isfinite(controlFrom) && std::isfinite(controlTarget))
+			return;
+
+		increment(stateResets);
+		reset();
+	}
+
+	template <typename SampleType>
+	void Compressor::detect(const SampleType* const* channels, int numChannels, int numSamples) noexcept
+	{
+		detectPeaks(channels, numChannels, numSamples);
+		convertLevelsToDecibels(0, numSamples);
+	}
+
+	template <typename SampleType>
+	float Compressor::detectPeaks(const SampleType* const* channels, int numChannels, int numSamples) noexcept
+	{
+		// Linked detector: the loudest channel drives the gain of all of them
+		std::fill(levels.begin(), levels.begin() + numSamples, 0.f);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const auto* data = channels[channel];
+
+			for (int i = 0; i < numSamples; ++i)
+				levels[(size_t)i] = std::max(levels[(size_t)i], (float)std::abs(data[i]));
+		}
+
+		auto peak = 0.f;
+
+		for (int i = 0; i < numSamples; ++i)
+			peak = std::max(peak, levels[(size_t)i]);
+
+		// Inf comes through the max as it is; NaN never does, as max() keeps the level it already has
+		if (!(peak <= std::numeric_limits<float>::max()))
+			return detectFinitePeaks(channels, numChannels, numSamples);
+
+		return peak;
+	}
+
+	template <typename SampleType>
+	float Compressor::detectFinitePeaks(const SampleType* const* channels, int numChannels, int numSamples) noexcept
+	{
+		std::fill(levels.begin(), levels.begin() + numSamples, 0.f);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const auto* data = channels[channel];
+
+			for (int i = 0; i < numSamples; ++i)
+			{
+				const auto level = (float)std::abs(data[i]);
+				levels[(size_t)i] = std::max(levels[(size_t)i], isNonFinite(level) ? 0.f : level);
+			}
+		}
+
+		auto peak = 0.f;
+
+		for (int i = 0; i < numSamples; ++i)
+			peak = std::max(peak, levels[(size_t)i]);
+
+		return peak;
+	}
+
+	void Compressor::convertLevelsToDecibels(int startSample, int endSample) noexcept
+	{
+		for (int i = startSample; i < endSample; ++i)
+			levels[(size_t)i] = tables->gainToDecibels(levels[(size_t)i]);
+	}
+
+	void Compressor::computeGain(int numSamples) noexcept
+	{
+		computeGainBetween(0, numSamples);
+	}
+
+	void Compressor::computeGainBetween(int startSample, int endSample) noexcept
+	{
+		for (int i = startSample; i < endSample; ++i)
+			gains[(size_t)i] = gainComputer.getGainDecibels(levels[(size_t)i]);
+	}
+
+	float Compressor::smoothEnvelope(int numSamples) noexcept
+	{
+		return smoothEnvelopeBetween(0, numSamples);
+	}
+
+	float Compressor::smoothEnvelopeBetween(int startSample, int endSample) noexcept
+	{
+		auto state = envelope;
+		auto minGainDb = 0.f;
+
+		for (int i = startSample; i < endSample; ++i)
+		{
+			const auto diff = gains[(size_t)i] - state;
+			state += (diff < 0.f ? attackCoefficient : releaseCoefficient) * diff;
+			gains[(size_t)i] = state;
+			minGainDb = std::min(minGainDb, state);
+		}
+
+		envelope = state;
+		return minGainDb;
+	}
+
+	float Compressor::computeControlRateGains(int numSamples) noexcept
+	{
+		const auto startPhase = gridPhase % controlInterval;
+		auto state = envelope;
+		auto minGainDb = 0.f;
+		auto peak = controlPeak;
+
+		// The envelope at the end of every interval that ends in this sub-block, from the detector's
+		// maximum over all of it, left in gains at the interval's last sample
+		for (int start = 0, phase = startPhase; start < numSamples; phase = 0)
+		{
+			const auto length = std::min(controlInterval - phase, numSamples - start);
+
+			for (int i = start; i < start + length; ++i)
+				peak = std::max(peak, levels[(size_t)i]);
+
+			start += length;
+
+			if (phase + length == controlInterval)
+			{
+				const auto diff = gainComputer.getGainDecibels(tables->gainToDecibels(peak)) - state;
+				state += (diff < 0.f ? controlAttackCoefficient : controlReleaseCoefficient) * diff;
+				gains[(size_t)start - 1] = state;
+				minGainDb = std::min(minGainDb, state);
+				peak = 0.f;
+			}
+		}
+
+		envelope = state;
+		controlPeak = peak;
+
+		// Grid points are interval ends, so the makeup finds the envelope it needs where it looks
+		advanceMakeup(numSamples, gains.data());
+
+		// The gain ramps to each interval's value across the next one
+		for (int start = 0, phase = startPhase; start < numSamples; phase = 0)
+		{
+			const auto length = std::min(controlInterval - phase, numSamples - start);
+			const auto end = start + length;
+			const auto reachesPoint = phase + length == controlInterval;
+			const auto pointEnvelope = reachesPoint ? gains[(size_t)end - 1] : 0.f;
+			const auto step = controlTarget - controlFrom;
+
+			for (int i = 0; i < length; ++i)
+				gains[(size_t)(start + i)] = controlFrom + step * controlRamp[(size_t)(phase + i)];
+
+			if (reachesPoint)
+			{
+				controlFrom = controlTarget;
+				controlTarget = getFactor(pointEnvelope, getGainOffset(end - 1));
+			}
+
+			start = end;
+		}
+
+		return minGainDb;
+	}
+
+	float Compressor::decayEnvelope(int numSamples, bool perSample) noexcept
+	{
+		// The envelope never goes above 0 dB, so with a 0 dB target it is always releasing:
+		// e[n] = e[0] * (1 - release)^n. Stepped the way smoothEnvelope() does it, since 1 - release
+		// rounded to float would be off by a good fraction of a percent for long release times.
+		const auto release = releaseCoefficient;
+		const auto minGainDb = numSamples > 0 ? envelope - release * envelope : 0.f;
+
+		if (perSample)
+		{
+			auto state = envelope;
+
+			for (int i = 0; i < numSamples; ++i)
+				gains[(size_t)i] = state -= release * state;
+
+			envelope = state;
+		}
+		else if (envelope != 0.f)
+		{
+			envelope = getDecayedEnvelope(envelope, numSamples);
+		}
+
+		// Far below anything audible, and exactly zero lets the next quiet block take the constant gain path
+		if (envelope > -1.0e-6f)
+			envelope = 0.f;
+
+		return minGainDb;
+	}
+
+	float Compressor::getDecayedEnvelope(float startDb, int numSamples) const noexcept
+	{
+		return (float)((double)startDb * std::pow(1.0 - (double)releaseCoefficient, numSamples));
+	}
+
+	template <typename SampleType>
+	void Compressor::applyGain(SampleType* const* channels, int numChannels, int numSamples, float minGainDb) noexcept
+	{
+		// Dry/wet mix folded into one factor per sample: x * (1 - mix) + x * g * mix
+		const auto mix = settings.mix;
+
+		if (!makeupMoving)
+		{
+			const auto offset = getGainOffset(0);
+
+			for (int i = 0; i < numSamples; ++i)
+				gains[(size_t)i] = 1.f - mix + mix * tables->decibelsToGain(gains[(size_t)i] + offset);
+		}
+		else
+		{
+			for (int i = 0; i < numSamples; ++i)
+				gains[(size_t)i] = 1.f - mix + mix * tables->decibelsToGain(gains[(size_t)i] + settings.gain + offsets[(size_t)i]);
+		}
+
+		applyFactors(channels, numChannels, numSamples, minGainDb);
+	}
+
+	template <typename SampleType>
+	void Compressor::applyFactors(SampleType* const* channels, int numChannels, int numSamples, float minGainDb) noexcept
+	{
+		if (handoverDone < handoverLength)
+			blendHandover(numSamples);
+
+		const auto minGain = tables->decibelsToGain(minGainDb);
+		const auto numMeterChannels = meters.getNumChannels();
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const auto channelLevels = applyAndMeasure(channels[channel], gains.data(), numSamples);
+
+			// NaN gets past the detector but can't leave a finite sum of squares, and neither can Inf or a bad
+			// gain: the rare channel with any of them is cleaned up afterwards and sits this block out of the meter
+			if (!std::isfinite(channelLevels.outputSumSquares))
+				increment(nonFiniteSamples, (std::uint64_t)zeroNonFinite(channels[channel], numSamples));
+			else if (channel < numMeterChannels)
+				meters[channel].add(channelLevels, minGain, numSamples);
+		}
+	}
+
+	void Compressor::blendHandover(int numSamples) noexcept
+	{
+		const auto length = std::min(numSamples, handoverLength - handoverDone);
+
+		for (int i = 0; i < length; ++i)
+		{
+			// The old ramp to its end, then held there, as nothing later is known about it
+			const auto done = handoverDone + i + 1;
+			const auto old = handoverFrom + handoverStep * (float)std::min(handoverPosition + done, handoverInterval);
+			const auto weight = (float)done / (float)handoverLength;
+			gains[(size_t)i] = old + weight * (gains[(size_t)i] - old);
+		}
+	}
+
+	void Compressor::addSilenceToMeters(int numChannels, int numSamples, float minGainDb) noexcept
+	{
+		const auto minGain = tables->decibelsToGain(minGainDb);
+		const auto numMeterChannels = std::min(numChannels, meters.getNumChannels());
+
+		for (int channel = 0; channel < numMeterChannels; ++channel)
+			meters[channel].add({}, minGain, numSamples);
+	}
+
+	template void Compressor::process<float>(float* const*, int, int) noexcept;
+	template void Compressor::process<double>(double* const*, int, int) noexcept;
+	template void Compressor::track<float>(const float* const*, int, int) noexcept;
+	template void Compressor::track<double>(const double* const*, int, int) noexcept;
+	template void Compressor::detect<float>(const float* const*, int, int) noexcept;
+	template void Compressor::detect<double>(const double* const*, int, int) noexcept;
+	template void Compressor::applyGain<float>(float* const*, int, int, float) noexcept;
+	template void Compressor::applyGain<double>(double* const*, int, int, float) noexcept;
+}
@@ -0,0 +1,325 @@
+/*
+  ==============================================================================
+
+	JUCE-free compressor core: detector, gain computer, envelope and mix.
+
+	The plugin is a thin wrapper around this class; offline tools and
+	benchmarks link it directly through the CompressorV2Dsp library target.
+	process() works in place on any number of channels and any block length,
+	splitting internally at the prepared maximum block size.
+
+	The audio can be float or double; the stages that touch it are templates,
+	instantiated for both in Compressor.cpp, so a 64-bit host's buffers are
+	processed as they are. Detector levels, gains and the envelope are float
+	control signals either way and share one state, so switching precision
+	between blocks doesn't reset anything.
+
+	Everything slower than the audio moves on a grid of gridLength samples
+	counted from reset(), not from the start of each block, so the output
+	doesn't depend on how the caller splits its buffers: the same samples
+	with the same parameter changes at the same sample positions give the
+	same result whatever the block sizes.
+
+	With a morph time set, new settings don't land at once: process() walks
+	from the current ones to the new ones one grid cell at a time, each cell
+	taking the settings for its end. Ratio is interpolated as its slope, so
+	the curve moves evenly even across 1:1 <-> 100:1.
+
+	Each sub-block is classified after the detector's peak pass. Digital
+	silence skips everything but the meters and moves the envelope on with
+	the closed-form release decay. Leading samples that can't reach the
+	bottom of the knee skip the dB conversion and the gain curve, and their
+	envelope is the same decay sample by sample (a constant gain once it has
+	settled); from the first sample that can, the rest of the sub-block takes
+	the full path.
+
+	In eco mode (a control interval above 1) the detector still runs every
+	sample, but the gain curve, the envelope and both dB conversions run
+	once per interval, on the detector's maximum over it so that peaks
+	between the points aren't missed. The linear gain then ramps to that
+	point's value across the next interval, since an interval cut by a
+	block boundary can't know its maximum until it ends. Intervals are a
+	power of two, so they fall on the grid. Eco sub-blocks always take the
+	control-rate path; the quiet paths below are for the full rate. That
+	ramp runs up to an interval behind the envelope, so a finer interval
+	would drop the lag on the switch sample; instead the old ramp is played
+	out, held at its target, and crossfaded into the new gain over one old
+	interval.
+
+	Auto makeup adds a gain on top of the Gain setting. In curve mode it is
+	the reduction the transfer curve applies to a full scale level, worked
+	out again only when threshold, knee or ratio change. In running mode it
+	is a slow average of the envelope, taken at every grid point whose cell
+	wasn't digital silence, so it follows the material rather than the
+	worst case and holds through gaps. Either way the makeup moves with a
+	50 ms one-pole evaluated at the grid points and ramped linearly between
+	them, so a change never steps the gain. Makeup and Gain together stop at
+	FastMathTables::maxDecibels, 48 dB, the top of the tables the gain is
+	looked up in: a curve at -60 dB and 100:1 asks for 59 dB of makeup, and
+	Gain goes to 36, so past that the table would clip it unannounced.
+
+	NaN and Inf in the input are caught without a test per sample, by the
+	reductions the core runs anyway. Inf shows up as an infinite peak in the
+	detector, which then takes those samples as silence. NaN never wins the
+	detector's max, but it does reach the sum of squares the output metering
+	keeps, and a channel whose sum isn't finite has its bad samples zeroed
+	after the fact and is left out of the meters for that block. Silent
+	blocks don't get that far, so they are checked for anything but zeros.
+	Doubles too large for a float level count as infinite. As a last line,
+	the envelope and makeup are checked once per sub-block and start again
+	from 0 dB if they have gone non-finite anyway. Denormals are left to the
+	caller's flush-to-zero mode (ScopedNoDenormals in the plugin).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ChainSettings.h"
+#include "FastMath.h"
+#include "Metering.h"
+#include "StageProfiler.h"
+
+namespace Dsp
+{
+	// Static transfer curve, the knee maths the processor used in setKnee()
+	struct GainComputer
+	{
+		float threshold{}, kneeHalf{}, kneeWidth{}, slope{};
+
+		void setParameters(float thresholdDb, float kneeDb, float ratio) noexcept
+		{
+			threshold = thresholdDb;
+			kneeWidth = kneeDb;
+			kneeHalf = kneeDb * 0.5f;
+			slope = 1.f / ratio - 1.f;
+		}
+
+		// Gain change in dB (<= 0) for a detector level in dB
+		float getGainDecibels(float levelDb) const noexcept
+		{
+			const auto overShoot = levelDb - threshold;
+
+			if (overShoot <= -kneeHalf)
+				return 0.f;
+
+			if (overShoot <= kneeHalf)
+				return 0.5f * slope * (overShoot + kneeHalf) * (overShoot + kneeHalf) / kneeWidth;
+
+			return slope * overShoot;
+		}
+	};
+
+	enum class AutoMakeup
+	{
+		off,
+		curve,
+		running
+	};
+
+	// Sub-blocks process() ran down each path; ones that started quiet and then crossed the knee count as full.
+	// In eco mode every sub-block takes the control-rate path, and they are counted by what they held.
+	struct PathCounts
+	{
+		std::uint64_t silent{}, belowThreshold{}, full{};
+	};
+
+	// Samples process() found NaN or infinite and replaced with silence, and the times the envelope
+	// and makeup state had gone non-finite regardless and were started again from 0 dB
+	struct FaultCounts
+	{
+		std::uint64_t nonFiniteSamples{}, stateResets{};
+	};
+
+	class Compressor
+	{
+	public:
+		// Builds tables of its own unless given ones to share
+		explicit Compressor(std::shared_ptr<const FastMathTables> sharedTables = nullptr);
+
+		// Not realtime safe: allocates the scratch buffers
+		void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+		// What the scratch buffers hold on the heap, not counting the tables
+		size_t getHeapSizeInBytes() const noexcept;
+		void reset() noexcept;
+
+		// Moves to newSettings over the morph time, or at once if it's zero or nothing is prepared yet
+		void setParameters(const ChainSettings& newSettings) noexcept;
+		const ChainSettings& getParameters() const noexcept { return settings; }
+		const ChainSettings& getTargetParameters() const noexcept { return morphTarget; }
+
+		void setMorphTime(float milliseconds) noexcept { morphTimeMs = milliseconds; }
+
+		// The grid the morph, the makeup and the eco intervals move on, counted from reset()
+		static constexpr int gridLength{ 32 };
+
+		// Samples per gain computation: 1 for every sample, or a power of two up to maxControlInterval
+		// (others are rounded down to one)
+		static constexpr int maxControlInterval{ gridLength };
+		void setControlInterval(int samples) noexcept;
+		int getControlInterval() const noexcept { return controlInterval; }
+		bool isMorphing() const noexcept { return morphPosition < morphLength; }
+
+		void setAutoMakeup(AutoMakeup newMode) noexcept;
+		AutoMakeup getAutoMakeup() const noexcept { return autoMakeup; }
+		// Makeup added on top of the Gain setting at the end of the last block, in dB
+		float getMakeupDecibels() const noexcept { return makeupDb + (makeupNext - makeupDb) * (float)gridPhase / (float)gridLength; }
+
+		template <typename SampleType>
+		void process(SampleType* const* channels, int numChannels, int numSamples) noexcept;
+
+		// Moves the detector, envelope and makeup on as process() would, without touching the
+		// audio or the meters: keeps a bypassed instance ready to come back without a jump
+		template <typename SampleType>
+		void track(const SampleType* const* channels, int numChannels, int numSamples) noexcept;
+
+		// Optional collaborator, set before processing starts
+		void setProfiler(StageProfiler* newProfiler) noexcept { profiler = newProfiler; }
+
+		MeterBank& getMeters() noexcept { return meters; }
+		const MeterBank& getMeters() const noexcept { return meters; }
+		float getEnvelopeDecibels() const noexcept { return envelope; }
+		double getSampleRate() const noexcept { return sampleRate; }
+		int getMaximumBlockSize() const noexcept { return maximumBlockSize; }
+
+		// Readable from any thread
+		PathCounts getPathCounts() const noexcept;
+		void resetPathCounts() noexcept;
+		FaultCounts getFaultCounts() const noexcept;
+		void resetFaultCounts() noexcept;
+
+		// Samples of pre-roll after which two envelopes started from any states agree within toleranceDb,
+		// or the largest int if no amount of pre-roll is enough. The pre-roll should start a multiple of
+		// gridLength samples from the start of the stream, so that it reaches the same grid.
+		int getWarmUpSamples(float toleranceDb) const noexcept;
+
+		// The individual stages process() runs on its scratch buffers, public for benchmarking.
+		// numSamples must not exceed the prepared maximum block size.
+		template <typename SampleType>
+		void detect(const SampleType* const* channels, int numChannels, int numSamples) noexcept;
+		void computeGain(int numSamples) noexcept;
+		float smoothEnvelope(int numSamples) noexcept;
+		template <typename SampleType>
+		void applyGain(SampleType* const* channels, int numChannels, int numSamples, float minGainDb) noexcept;
+
+	private:
+		void applySettings(const ChainSettings& newSettings) noexcept;
+		void advanceMorph(int numSamples) noexcept;
+		void updateCoefficients() noexcept;
+
+		// Linked linear peak per sample into levels, returning the block's maximum; NaN and Inf count as silence
+		template <typename SampleType>
+		float detectPeaks(const SampleType* const* channels, int numChannels, int numSamples) noexcept;
+		// detectPeaks() again for the rare block with an infinite peak, masking those samples out
+		template <typename SampleType>
+		float detectFinitePeaks(const SampleType* const* channels, int numChannels, int numSamples) noexcept;
+		void convertLevelsToDecibels(int startSample, int endSample) noexcept;
+		void computeGainBetween(int startSample, int endSample) noexcept;
+		float smoothEnvelopeBetween(int startSample, int endSample) noexcept;
+
+		// The envelope releasing towards 0 dB over samples whose target gain is 0 dB, as
+		// gains[0, numSamples) or, without perSample, only the end state
+		float decayEnvelope(int numSamples, bool perSample) noexcept;
+		// Where that decay takes an envelope of startDb in numSamples
+		float getDecayedEnvelope(float startDb, int numSamples) const noexcept;
+		template <typename SampleType>
+		void applyFactors(SampleType* const* channels, int numChannels, int numSamples, float minGainDb) noexcept;
+		void addSilenceToMeters(int numChannels, int numSamples, float minGainDb) noexcept;
+
+		// Moves the makeup through the next numSamples, filling offsets[0, numSamples) if it moves in them.
+		// envelopeDb holds the envelope after each of those samples; without it, the envelope is taken
+		// to release towards 0 dB from where it is now.
+		void advanceMakeup(int numSamples, const float* envelopeDb) noexcept;
+		// At a grid point: the running average takes the envelope there and the makeup steps on a cell
+		void finishGridCell(float envelopeDb) noexcept;
+		// Clamped so the makeup plus Gain stays within FastMathTables::maxDecibels
+		float getMakeupTarget() const noexcept;
+		bool isMakeupSettled() const noexcept;
+		// For the running makeup, which cells of the next numSamples weren't digital silence
+		void markHeardCells(int numSamples, float blockPeak) noexcept;
+		// Offset in dB to add to the envelope at sample i of the current sub-block
+		float getGainOffset(int i) const noexcept { return settings.gain + (makeupMoving ? offsets[(size_t)i] : makeupDb); }
+
+		// Last thing in every sub-block: starts the state again if it isn't finite
+		void guardState() noexcept;
+
+		// Eco path from peak levels to gains[0, numSamples), returning the lowest envelope value.
+		// Moves the makeup on too, as it needs the envelope at the grid points.
+		float computeControlRateGains(int numSamples) noexcept;
+		// Linear gain with the dry mix folded in, for an envelope and an offset in dB
+		float getFactor(float envelopeDb, float offsetDb) const noexcept
+		{
+			return 1.f - settings.mix + settings.mix * tables->decibelsToGain(envelopeDb + offsetDb);
+		}
+		static void increment(std::atomic<std::uint64_t>& counter, std::uint64_t amount = 1) noexcept;
+		static std::uint64_t countSinceReset(const std::atomic<std::uint64_t>& counter, const std::atomic<std::uint64_t>& atReset) noexcept;
+		static void markReset(const std::atomic<std::uint64_t>& counter, std::atomic<std::uint64_t>& atReset) noexcept;
+
+		ChainSettings settings, morphStart, morphTarget;
+		float morphTimeMs{};
+		int morphLength{}, morphPosition{};
+
+		GainComputer gainComputer;
+		std::shared_ptr<const FastMathTables> tables;
+		StageProfiler* profiler{};
+		MeterBank meters;
+
+		double sampleRate{ 44100.0 };
+		int maximumBlockSize{};
+
+		float attackCoefficient{}, releaseCoefficient{};
+		float envelope{};
+
+		// Samples into the current grid cell
+		int gridPhase{};
+
+		// The envelope coefficients over one whole control interval, and the ramp across it. The gain
+		// factor ramps from controlFrom to controlTarget through the current interval, and controlPeak
+		// is the detector's maximum over the part of it already seen.
+		int controlInterval{ 1 };
+		float controlAttackCoefficient{}, controlReleaseCoefficient{};
+		std::array<float, maxControlInterval> controlRamp{};
+		float controlFrom{ 1.f }, controlTarget{ 1.f }, controlPeak{};
+
+		// Handing over to a finer interval: the old ramp's start and step per sample, how far into
+		// its interval it was at the switch, and how far the crossfade to the new gain has got
+		float handoverFrom{}, handoverStep{};
+		int handoverInterval{}, handoverPosition{}, handoverLength{}, handoverDone{};
+		void blendHandover(int numSamples) noexcept;
+
+		// Makeup: the curve's estimate, the running average of the envelope, and the applied value,
+		// which ramps from makeupDb at the start of the current grid cell to makeupNext at its end.
+		// makeupMoving says whether offsets holds it per sample for the current sub-block.
+		static constexpr double makeupSmoothingSeconds{ 0.05 };
+		static constexpr double runningMakeupSeconds{ 3.0 };
+		AutoMakeup autoMakeup{ AutoMakeup::off };
+		float curveMakeup{}, runningReduction{};
+		float makeupDb{}, makeupNext{};
+		// What is left of a makeup change after one grid cell, and the running average's step per cell
+		float makeupCellDecay{}, runningMakeupAmount{};
+		bool makeupMoving{}, cellHeard{};
+
+		// Linear level below which the gain computer can only return 0 dB
+		float quietLevel{};
+		std::atomic<std::uint64_t> silentBlocks{}, belowThresholdBlocks{}, fullBlocks{};
+		std::atomic<std::uint64_t> nonFiniteSamples{}, stateResets{};
+
+		// The counts at the last reset. Only the audio thread writes the counts and only readers write
+		// these, so a reset is a snapshot the getters subtract rather than a store racing an increment
+		std::atomic<std::uint64_t> silentBlocksAtReset{}, belowThresholdBlocksAtReset{}, fullBlocksAtReset{};
+		std::atomic<std::uint64_t> nonFiniteSamplesAtReset{}, stateResetsAtReset{};
+
+		// One value per sample: detector level, then the smoothed gain, both in dB, and the makeup
+		std::vector<float> levels;
+		std::vector<float> gains;
+		std::vector<float> offsets;
+		// One flag per grid cell a sub-block touches, from markHeardCells()
+		std::vector<std::uint8_t> heardCells;
+	};
+}
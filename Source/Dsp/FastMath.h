@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+	Table based decibel <-> gain conversion for the per-sample paths.
+
+	The tables are immutable once built, so one instance is shared by every
+	plugin instance through SharedResources.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Dsp
+{
+	class FastMathTables
+	{
+	public:
+		static constexpr float minDecibels{ -144.f };
+		static constexpr float maxDecibels{ 48.f };
+		static constexpr int pointsPerDecibel{ 8 };
+		static constexpr int mantissaBits{ 10 };
+
+		FastMathTables()
+		{
+			const auto numGainPoints = (int)((maxDecibels - minDecibels) * pointsPerDecibel) + 2;
+			gains.resize((size_t)numGainPoints);
+
+			for (int i = 0; i < numGainPoints; ++i)
+			{
+				gains[(size_t)i] = std::pow(10.f, (minDecibels + (float)i / (float)pointsPerDecibel) * 0.05f);
+			}
+
+			const auto numLogPoints = (1 << mantissaBits) + 1;
+			log2Mantissa.resize((size_t)numLogPoints);
+
+			for (int i = 0; i < numLogPoints; ++i)
+			{
+				log2Mantissa[(size_t)i] = std::log2(1.f + (float)i / (float)(1 << mantissaBits));
+			}
+		}
+
+		float decibelsToGain(float decibels) const noexcept
+		{
+			// NaN too, which would otherwise index the table with garbage
+			if (!(decibels > minDecibels))
+				return 0.f;
+
+			if (decibels >= maxDecibels)
+				decibels = maxDecibels;
+
+			const auto position = (decibels - minDecibels) * (float)pointsPerDecibel;
+			const auto index = (int)position;
+			const auto fraction = position - (float)index;
+
+			return gains[(size_t)index] + fraction * (gains[(size_t)index + 1] - gains[(size_t)index]);
+		}
+
+		float gainToDecibels(float gain) const noexcept
+		{
+			if (!(gain > minGain))
+				return minDecibels;
+
+			std::uint32_t bits;
+			std::memcpy(&bits, &gain, sizeof(bits));
+
+			const auto exponent = (int)((bits >> 23) & 0xff) - 127;
+			const auto index = (bits >> (23 - mantissaBits)) & ((1u << mantissaBits) - 1);
+			const auto fraction = (float)(bits & ((1u << (23 - mantissaBits)) - 1)) / (float)(1u << (23 - mantissaBits));
+			const auto log2Value = (float)exponent + log2Mantissa[index] + fraction * (log2Mantissa[index + 1] - log2Mantissa[index]);
+
+			return log2Value * decibelsPerOctave;
+		}
+
+		size_t getSizeInBytes() const noexcept
+		{
+			return sizeof(*this) + (gains.size() + log2Mantissa.size()) * sizeof(float);
+		}
+
+	private:
+		static constexpr float decibelsPerOctave{ 6.0205999f };
+		// 10^(minDecibels / 20), anything quieter reports the floor
+		static constexpr float minGain{ 6.3095734e-8f };
+
+		std::vector<float> gains;
+		std::vector<float> log2Mantissa;
+	};
+}
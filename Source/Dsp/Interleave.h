@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+	Conversion between interleaved sample frames and per-channel buffers.
+
+	Stereo, the common case for masters, has SSE and NEON paths; other
+	channel counts use a plain strided loop.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COMPRESSORV2_INTERLEAVE_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define COMPRESSORV2_INTERLEAVE_NEON 1
+#endif
+
+namespace Dsp
+{
+	// channels[c][i] = interleaved[i * numChannels + c]
+	inline void deinterleave(const float* interleaved, float* const* channels, int numChannels, int numSamples) noexcept
+	{
+		int i = 0;
+
+		if (numChannels == 2)
+		{
+			auto* left = channels[0];
+			auto* right = channels[1];
+
+#if COMPRESSORV2_INTERLEAVE_SSE
+			for (; i + 4 <= numSamples; i += 4)
+			{
+				const auto a = _mm_loadu_ps(interleaved + 2 * i);
+				const auto b = _mm_loadu_ps(interleaved + 2 * i + 4);
+				_mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+#elif COMPRESSORV2_INTERLEAVE_NEON
+			for (; i + 4 <= numSamples; i += 4)
+			{
+				const auto frames = vld2q_f32(interleaved + 2 * i);
+				vst1q_f32(left + i, frames.val[0]);
+				vst1q_f32(right + i, frames.val[1]);
+			}
+#endif
+			for (; i < numSamples; ++i)
+			{
+				left[i] = interleaved[2 * i];
+				right[i] = interleaved[2 * i + 1];
+			}
+
+			return;
+		}
+
+		for (int c = 0; c < numChannels; ++c)
+		{
+			auto* destination = channels[c];
+			auto* source = interleaved + c;
+
+			for (i = 0; i < numSamples; ++i)
+				destination[i] = source[i * numChannels];
+		}
+	}
+
+	// interleaved[i * numChannels + c] = channels[c][i]
+	inline void interleave(const float* const* channels, float* interleaved, int numChannels, int numSamples) noexcept
+	{
+		int i = 0;
+
+		if (numChannels == 2)
+		{
+			const auto* left = channels[0];
+			const auto* right = channels[1];
+
+#if COMPRESSORV2_INTERLEAVE_SSE
+			for (; i + 4 <= numSamples; i += 4)
+			{
+				const auto l = _mm_loadu_ps(left + i);
+				const auto r = _mm_loadu_ps(right + i);
+				_mm_storeu_ps(interleaved + 2 * i, _mm_unpacklo_ps(l, r));
+				_mm_storeu_ps(interleaved + 2 * i + 4, _mm_unpackhi_ps(l, r));
+			}
+#elif COMPRESSORV2_INTERLEAVE_NEON
+			for (; i + 4 <= numSamples; i += 4)
+			{
+				float32x4x2_t frames;
+				frames.val[0] = vld1q_f32(left + i);
+				frames.val[1] = vld1q_f32(right + i);
+				vst2q_f32(interleaved + 2 * i, frames);
+			}
+#endif
+			for (; i < numSamples; ++i)
+			{
+				interleaved[2 * i] = left[i];
+				interleaved[2 * i + 1] = right[i];
+			}
+
+			return;
+		}
+
+		for (int c = 0; c < numChannels; ++c)
+		{
+			const auto* source = channels[c];
+			auto* destination = interleaved + c;
+
+			for (i = 0; i < numSamples; ++i)
+				destination[i * numChannels] = source[i];
+		}
+	}
+}
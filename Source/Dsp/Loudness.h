@@ -0,0 +1,385 @@
+/*
+  ==============================================================================
+
+	ITU-R BS.1770 / EBU R128 loudness, JUCE-free, split across two threads.
+
+	KWeightedMeter runs on the audio thread: the two K-weighting biquads per
+	channel and the channel sum of squares, handed over as one mean square
+	per 100 ms step. That is all the audio thread does. The recursion is
+	serial in time, but stereo's two channels fill the two doubles of an
+	SSE2 register, so they are filtered together.
+
+	LoudnessGate takes those steps on any other thread and derives momentary
+	(400 ms), short-term (3 s), integrated and loudness range. The gating
+	blocks are never stored: each goes into a fixed histogram of 0.1 LU bins
+	from -70 to +5 LUFS, keeping the count and the summed power per bin, so a
+	programme of any length costs the same memory and time per update.
+	Integrated loudness is exact but for the bin straddling the relative
+	gate; the range is read off bin centres, 0.1 LU resolution.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COMPRESSORV2_LOUDNESS_SSE 1
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace Dsp
+{
+	// Mean squares of the 100 ms steps completed during one process() call
+	struct LoudnessSteps
+	{
+		static constexpr int maxSteps{ 16 };
+
+		int count{};
+		// Steps that ended in the call past maxSteps, which a block over 1.6 s can have
+		int lost{};
+		// Samples into the call at which each step ended, 1 to numSamples
+		std::array<int, maxSteps> endSample{};
+		std::array<float, maxSteps> meanSquare{};
+	};
+
+	inline double meanSquareToLufs(double meanSquare) noexcept
+	{
+		return meanSquare > 0.0 ? -0.691 + 10.0 * std::log10(meanSquare) : -std::numeric_limits<double>::infinity();
+	}
+
+	inline double lufsToMeanSquare(double lufs) noexcept
+	{
+		return std::pow(10.0, (lufs + 0.691) / 10.0);
+	}
+
+	class KWeightedMeter
+	{
+	public:
+		static constexpr int maxChannels{ 2 };
+
+		void prepare(double sampleRate, int newNumChannels) noexcept
+		{
+			numChannels = std::clamp(newNumChannels, 1, maxChannels);
+			stepLength = std::max(1, (int)std::lround(sampleRate * 0.1));
+
+			// Pre-filter (high shelf) and RLB high pass, designed for any rate as in BS.1770's derivation
+			constexpr auto pi = 3.14159265358979323846;
+
+			{
+				const auto k = std::tan(pi * 1681.974450955533 / sampleRate);
+				const auto q = 0.7071752369554196;
+				const auto vh = std::pow(10.0, 3.999843853973347 / 20.0);
+				const auto vb = std::pow(vh, 0.4996667741545416);
+				const auto a0 = 1.0 + k / q + k * k;
+
+				shelf = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+					2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+			}
+
+			{
+				const auto k = std::tan(pi * 38.13547087602444 / sampleRate);
+				const auto q = 0.5003270373238773;
+				const auto a0 = 1.0 + k / q + k * k;
+
+				highPass = { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+			}
+
+			reset();
+		}
+
+		void reset() noexcept
+		{
+			states = {};
+			sum = 0.0;
+			stepPosition = 0;
+			steps.count = steps.lost = 0;
+		}
+
+		// Channels beyond the prepared count are ignored; all weights are 1 for mono and stereo
+		template <typename SampleType>
+		void process(const SampleType* const* channels, int numSamples) noexcept
+		{
+			steps.count = steps.lost = 0;
+
+			for (int done = 0; done < numSamples;)
+			{
+				const auto length = std::min(numSamples - done, stepLength - stepPosition);
+
+				if (numChannels == 2)
+				{
+					sum += filterStereo(channels[0] + done, channels[1] + done, length);
+				}
+				else
+				{
+					sum += filterChannel(channels[0] + done, length, states[0]);
+				}
+
+				done += length;
+				stepPosition += length;
+
+				if (stepPosition == stepLength)
+				{
+					if (steps.count < LoudnessSteps::maxSteps)
+					{
+						steps.endSample[(size_t)steps.count] = done;
+						steps.meanSquare[(size_t)steps.count] = (float)(sum / stepLength);
+						++steps.count;
+					}
+					else
+					{
+						++steps.lost;
+					}
+
+					sum = 0.0;
+					stepPosition = 0;
+				}
+			}
+		}
+
+		// Steps completed by the last process() call
+		const LoudnessSteps& getSteps() const noexcept { return steps; }
+
+	private:
+		struct Biquad
+		{
+			double b0{ 1.0 }, b1{}, b2{}, a1{}, a2{};
+		};
+
+		// Transposed direct form II for both stages
+		struct ChannelState
+		{
+			double s1{}, s2{}, h1{}, h2{};
+		};
+
+		// Both stages in one pass, so each sample is loaded once
+		template <typename SampleType>
+		double filterChannel(const SampleType* input, int numSamples, ChannelState& state) const noexcept
+		{
+			auto s1 = state.s1, s2 = state.s2, h1 = state.h1, h2 = state.h2;
+			auto energy = 0.0;
+
+			for (int i = 0; i < numSamples; ++i)
+			{
+				const auto x = (double)input[i];
+				const auto y = shelf.b0 * x + s1;
+				s1 = shelf.b1 * x - shelf.a1 * y + s2;
+				s2 = shelf.b2 * x - shelf.a2 * y;
+
+				const auto z = highPass.b0 * y + h1;
+				h1 = highPass.b1 * y - highPass.a1 * z + h2;
+				h2 = highPass.b2 * y - highPass.a2 * z;
+
+				energy += z * z;
+			}
+
+			return settle(state, { s1, s2, h1, h2 }, energy);
+		}
+
+		// The same as filterChannel on each, lane 0 left and lane 1 right
+		template <typename SampleType>
+		double filterStereo(const SampleType* left, const SampleType* right, int numSamples) noexcept
+		{
+		   #if COMPRESSORV2_LOUDNESS_SSE
+			const auto b0 = _mm_set1_pd(shelf.b0), b1 = _mm_set1_pd(shelf.b1), b2 = _mm_set1_pd(shelf.b2);
+			const auto a1 = _mm_set1_pd(shelf.a1), a2 = _mm_set1_pd(shelf.a2);
+			const auto hb0 = _mm_set1_pd(highPass.b0), hb1 = _mm_set1_pd(highPass.b1), hb2 = _mm_set1_pd(highPass.b2);
+			const auto ha1 = _mm_set1_pd(highPass.a1), ha2 = _mm_set1_pd(highPass.a2);
+
+			auto& l = states[0];
+			auto& r = states[1];
+			auto s1 = _mm_set_pd(r.s1, l.s1), s2 = _mm_set_pd(r.s2, l.s2), h1 = _mm_set_pd(r.h1, l.h1), h2 = _mm_set_pd(r.h2, l.h2);
+			auto energy = _mm_setzero_pd();
+
+			for (int i = 0; i < numSamples; ++i)
+			{
+				const auto x = _mm_set_pd((double)right[i], (double)left[i]);
+				const auto y = _mm_add_pd(_mm_mul_pd(b0, x), s1);
+				s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, x), _mm_mul_pd(a1, y)), s2);
+				s2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+
+				const auto z = _mm_add_pd(_mm_mul_pd(hb0, y), h1);
+				h1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, y), _mm_mul_pd(ha1, z)), h2);
+				h2 = _mm_sub_pd(_mm_mul_pd(hb2, y), _mm_mul_pd(ha2, z));
+
+				energy = _mm_add_pd(energy, _mm_mul_pd(z, z));
+			}
+
+			const auto lane = [](__m128d v, int index)
+			{
+				return _mm_cvtsd_f64(index == 0 ? v : _mm_unpackhi_pd(v, v));
+			};
+
+			return settle(l, { lane(s1, 0), lane(s2, 0), lane(h1, 0), lane(h2, 0) }, lane(energy, 0))
+				+ settle(r, { lane(s1, 1), lane(s2, 1), lane(h1, 1), lane(h2, 1) }, lane(energy, 1));
+		   #else
+			return filterChannel(left, numSamples, states[0]) + filterChannel(right, numSamples, states[1]);
+		   #endif
+		}
+
+		// Stores a channel's state after a run, returning the run's energy
+		static double settle(ChannelState& state, const ChannelState& next, double energy) noexcept
+		{
+			// A NaN or Inf in the input would ring in the filters for good; that step's energy goes with it
+			if (!std::isfinite(energy))
+			{
+				state = {};
+				return 0.0;
+			}
+
+			// Keep silence from leaving denormals in the state
+			constexpr auto tiny = 1e-30;
+			state = { std::abs(next.s1) < tiny ? 0.0 : next.s1, std::abs(next.s2) < tiny ? 0.0 : next.s2,
+				std::abs(next.h1) < tiny ? 0.0 : next.h1, std::abs(next.h2) < tiny ? 0.0 : next.h2 };
+			return energy;
+		}
+
+		Biquad shelf, highPass;
+		std::array<ChannelState, maxChannels> states{};
+		int numChannels{ 2 };
+
+		int stepLength{ 4410 }, stepPosition{};
+		double sum{};
+		LoudnessSteps steps;
+	};
+
+	class LoudnessGate
+	{
+	public:
+		static constexpr double absoluteGate{ -70.0 };
+		static constexpr double histogramTop{ 5.0 };
+		static constexpr double binWidth{ 0.1 };
+		static constexpr int numBins{ (int)((histogramTop - absoluteGate) / binWidth) };
+
+		void reset() noexcept
+		{
+			recent = {};
+			numSteps = 0;
+			blocks.clear();
+			shortTermBlocks.clear();
+		}
+
+		// One 100 ms step's mean square of the K-weighted, channel summed signal
+		void addStep(double meanSquare) noexcept
+		{
+			recent[numSteps % recent.size()] = meanSquare;
+			++numSteps;
+
+			// Gating blocks overlap by 75% for integrated loudness; the range uses short-term at 10 Hz
+			if (numSteps >= momentarySteps)
+				blocks.add(getMeanSquare(momentarySteps));
+
+			if (numSteps >= shortTermSteps)
+				shortTermBlocks.add(getMeanSquare(shortTermSteps));
+		}
+
+		double getMomentary() const noexcept { return numSteps >= momentarySteps ? meanSquareToLufs(getMeanSquare(momentarySteps)) : -infinity; }
+		double getShortTerm() const noexcept { return numSteps >= shortTermSteps ? meanSquareToLufs(getMeanSquare(shortTermSteps)) : -infinity; }
+
+		double getIntegrated() const noexcept
+		{
+			if (blocks.total == 0)
+				return -infinity;
+
+			const auto firstBin = blocks.getBin(meanSquareToLufs(blocks.totalPower / (double)blocks.total) - 10.0);
+			std::uint64_t count{};
+			auto power = 0.0;
+
+			for (int bin = firstBin; bin < numBins; ++bin)
+			{
+				count += blocks.counts[(size_t)bin];
+				power += blocks.power[(size_t)bin];
+			}
+
+			return count > 0 ? meanSquareToLufs(power / (double)count) : -infinity;
+		}
+
+		// EBU Tech 3342: spread between the 10th and 95th percentile of the gated short-term loudness
+		double getLoudnessRange() const noexcept
+		{
+			if (shortTermBlocks.total == 0)
+				return 0.0;
+
+			const auto firstBin = shortTermBlocks.getBin(meanSquareToLufs(shortTermBlocks.totalPower / (double)shortTermBlocks.total) - 20.0);
+			std::uint64_t count{};
+
+			for (int bin = firstBin; bin < numBins; ++bin)
+				count += shortTermBlocks.counts[(size_t)bin];
+
+			if (count == 0)
+				return 0.0;
+
+			const auto percentile = [&](double fraction)
+			{
+				const auto target = (std::uint64_t)(fraction * (double)(count - 1));
+				std::uint64_t seen{};
+
+				for (int bin = firstBin; bin < numBins; ++bin)
+				{
+					seen += shortTermBlocks.counts[(size_t)bin];
+
+					if (seen > target)
+						return absoluteGate + (bin + 0.5) * binWidth;
+				}
+
+				return histogramTop;
+			};
+
+			return percentile(0.95) - percentile(0.1);
+		}
+
+	private:
+		static constexpr int momentarySteps{ 4 };
+		static constexpr int shortTermSteps{ 30 };
+		static constexpr double infinity{ std::numeric_limits<double>::infinity() };
+
+		struct Histogram
+		{
+			std::array<std::uint64_t, numBins> counts{};
+			std::array<double, numBins> power{};
+			std::uint64_t total{};
+			double totalPower{};
+
+			static int getBin(double lufs) noexcept
+			{
+				return std::clamp((int)std::floor((lufs - absoluteGate) / binWidth), 0, numBins - 1);
+			}
+
+			// Below the absolute gate blocks aren't counted at all
+			void add(double meanSquare) noexcept
+			{
+				const auto lufs = meanSquareToLufs(meanSquare);
+
+				if (!(lufs >= absoluteGate))
+					return;
+
+				const auto bin = getBin(lufs);
+				++counts[(size_t)bin];
+				power[(size_t)bin] += meanSquare;
+				++total;
+				totalPower += meanSquare;
+			}
+
+			void clear() noexcept { *this = {}; }
+		};
+
+		double getMeanSquare(int numRecent) const noexcept
+		{
+			auto sum = 0.0;
+
+			for (int i = 1; i <= numRecent; ++i)
+				sum += recent[(size_t)((numSteps - i) % recent.size())];
+
+			return sum / numRecent;
+		}
+
+		std::array<double, shortTermSteps> recent{};
+		std::uint64_t numSteps{};
+		Histogram blocks, shortTermBlocks;
+	};
+}
@@ -0,0 +1,191 @@
+/*
+  ==============================================================================
+
+	Input/output metering.
+
+	The audio thread only gathers raw peak and sum-of-squares values, in the
+	same pass that writes the output, and accumulates them into a ChannelMeter
+	until a consumer takes them. Conversion to dB and meter ballistics happen
+	on the consumer thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+namespace Dsp
+{
+	struct ChannelLevels
+	{
+		float inputPeak{}, inputSumSquares{};
+		float outputPeak{}, outputSumSquares{};
+	};
+
+	// data[i] *= factors[i], measuring the signal before and after in the same pass.
+	// Four independent lanes keep the reductions vectorisable. Works on float or double
+	// audio; the factors and the results stay float.
+	template <typename SampleType>
+	inline ChannelLevels applyAndMeasure(SampleType* data, const float* factors, int numSamples) noexcept
+	{
+		constexpr int lanes{ 4 };
+
+		SampleType inPeak[lanes]{}, inSum[lanes]{}, outPeak[lanes]{}, outSum[lanes]{};
+
+		int i = 0;
+
+		for (; i + lanes <= numSamples; i += lanes)
+		{
+			for (int l = 0; l < lanes; ++l)
+			{
+				const auto x = data[i + l];
+				const auto y = x * (SampleType)factors[i + l];
+				data[i + l] = y;
+
+				inPeak[l] = std::max(inPeak[l], std::abs(x));
+				inSum[l] += x * x;
+				outPeak[l] = std::max(outPeak[l], std::abs(y));
+				outSum[l] += y * y;
+			}
+		}
+
+		for (; i < numSamples; ++i)
+		{
+			const auto x = data[i];
+			const auto y = x * (SampleType)factors[i];
+			data[i] = y;
+
+			inPeak[0] = std::max(inPeak[0], std::abs(x));
+			inSum[0] += x * x;
+			outPeak[0] = std::max(outPeak[0], std::abs(y));
+			outSum[0] += y * y;
+		}
+
+		ChannelLevels levels;
+
+		for (int l = 0; l < lanes; ++l)
+		{
+			levels.inputPeak = std::max(levels.inputPeak, (float)inPeak[l]);
+			levels.inputSumSquares += (float)inSum[l];
+			levels.outputPeak = std::max(levels.outputPeak, (float)outPeak[l]);
+			levels.outputSumSquares += (float)outSum[l];
+		}
+
+		return levels;
+	}
+
+	struct MeterReading
+	{
+		float inputPeak{}, inputSumSquares{};
+		float outputPeak{}, outputSumSquares{};
+		float minGain{ 1.f };
+		int numSamples{};
+
+		float getInputRms() const noexcept { return numSamples > 0 ? std::sqrt(inputSumSquares / (float)numSamples) : 0.f; }
+		float getOutputRms() const noexcept { return numSamples > 0 ? std::sqrt(outputSumSquares / (float)numSamples) : 0.f; }
+	};
+
+	// Written once per block by the audio thread, emptied by a consumer with take().
+	class ChannelMeter
+	{
+	public:
+		void add(const ChannelLevels& levels, float gain, int numSamples) noexcept
+		{
+			update(inputPeak, levels.inputPeak, [](float a, float b) { return std::max(a, b); });
+			update(inputSumSquares, levels.inputSumSquares, [](float a, float b) { return a + b; });
+			update(outputPeak, levels.outputPeak, [](float a, float b) { return std::max(a, b); });
+			update(outputSumSquares, levels.outputSumSquares, [](float a, float b) { return a + b; });
+			update(minGain, gain, [](float a, float b) { return std::min(a, b); });
+			samples.fetch_add(numSamples, std::memory_order_release);
+		}
+
+		MeterReading take() noexcept
+		{
+			MeterReading reading;
+			reading.numSamples = samples.exchange(0, std::memory_order_acquire);
+			reading.inputPeak = inputPeak.exchange(0.f, std::memory_order_relaxed);
+			reading.inputSumSquares = inputSumSquares.exchange(0.f, std::memory_order_relaxed);
+			reading.outputPeak = outputPeak.exchange(0.f, std::memory_order_relaxed);
+			reading.outputSumSquares = outputSumSquares.exchange(0.f, std::memory_order_relaxed);
+			reading.minGain = minGain.exchange(1.f, std::memory_order_relaxed);
+			return reading;
+		}
+
+	private:
+		template <typename Combine>
+		static void update(std::atomic<float>& target, float value, Combine combine) noexcept
+		{
+			auto current = target.load(std::memory_order_relaxed);
+			while (!target.compare_exchange_weak(current, combine(current, value), std::memory_order_relaxed)) {}
+		}
+
+		std::atomic<float> inputPeak{}, inputSumSquares{};
+		std::atomic<float> outputPeak{}, outputSumSquares{};
+		std::atomic<float> minGain{ 1.f };
+		std::atomic<int> samples{};
+	};
+
+	class MeterBank
+	{
+	public:
+		static constexpr int maxChannels{ 16 };
+
+		void setNumChannels(int newNumChannels) noexcept { numChannels.store(std::min(newNumChannels, maxChannels), std::memory_order_relaxed); }
+		int getNumChannels() const noexcept { return numChannels.load(std::memory_order_relaxed); }
+
+		ChannelMeter& operator[](int channel) noexcept { return channels[(size_t)channel]; }
+		const ChannelMeter& operator[](int channel) const noexcept { return channels[(size_t)channel]; }
+
+	private:
+		std::array<ChannelMeter, maxChannels> channels;
+		std::atomic<int> numChannels{};
+	};
+
+	// Consumer side: turns readings into dB values with peak hold and a constant fall-off rate.
+	class MeterBallistics
+	{
+	public:
+		static constexpr float floorDecibels{ -100.f };
+
+		MeterBallistics(float holdTimeSeconds = 1.5f, float fallDecibelsPerSecond = 24.f)
+			: holdTime(holdTimeSeconds), fallRate(fallDecibelsPerSecond)
+		{
+		}
+
+		void update(float peak, float rms, float elapsedSeconds) noexcept
+		{
+			const auto fall = fallRate * elapsedSeconds;
+
+			rmsDecibels = std::max(toDecibels(rms), rmsDecibels - fall);
+			peakDecibels = std::max(toDecibels(peak), peakDecibels - fall);
+
+			if (peakDecibels >= heldPeakDecibels)
+			{
+				heldPeakDecibels = peakDecibels;
+				holdRemaining = holdTime;
+			}
+			else if ((holdRemaining -= elapsedSeconds) <= 0.f)
+			{
+				heldPeakDecibels = std::max(peakDecibels, heldPeakDecibels - fall);
+			}
+		}
+
+		float getRmsDecibels() const noexcept { return rmsDecibels; }
+		float getPeakDecibels() const noexcept { return peakDecibels; }
+		float getHeldPeakDecibels() const noexcept { return heldPeakDecibels; }
+
+		static float toDecibels(float gain) noexcept
+		{
+			return gain > 0.f ? std::max(20.f * std::log10(gain), floorDecibels) : floorDecibels;
+		}
+
+	private:
+		float holdTime, fallRate;
+		float holdRemaining{};
+		float rmsDecibels{ floorDecibels }, peakDecibels{ floorDecibels }, heldPeakDecibels{ floorDecibels };
+	};
+}
@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+	Double precision reference for the compressor's intended behaviour.
+
+	Written for clarity, not speed: exact log10/pow instead of tables, no
+	block splitting and no scratch buffers. It follows the same signal flow
+	as Dsp::Compressor, so the two should only differ by rounding and table
+	error:
+
+		linked peak detector -> dB (floored at -144 dB, like the tables)
+		-> knee and ratio (setKnee() maths) -> one-pole envelope in dB,
+		attack while the gain falls, release while it rises
+		-> makeup and dry/wet mix
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "ChainSettings.h"
+
+namespace Dsp
+{
+	class ReferenceCompressor
+	{
+	public:
+		static constexpr double floorDecibels{ -144.0 };
+
+		void prepare(double newSampleRate)
+		{
+			sampleRate = newSampleRate;
+			setParameters(settings);
+			reset();
+		}
+
+		void reset() { envelope = 0.0; }
+
+		void setParameters(const ChainSettings& newSettings)
+		{
+			settings = newSettings;
+			attackCoefficient = getSmoothingCoefficient(settings.attack);
+			releaseCoefficient = getSmoothingCoefficient(settings.release);
+		}
+
+		// Static curve: gain change in dB (<= 0) for a detector level in dB
+		static double getGainDecibels(const ChainSettings& s, double levelDb)
+		{
+			const auto overShoot = levelDb - (double)s.threshold;
+			const auto kneeHalf = 0.5 * (double)s.knee;
+			const auto slope = 1.0 / (double)s.ratio - 1.0;
+
+			if (overShoot <= -kneeHalf)
+				return 0.0;
+
+			if (overShoot <= kneeHalf)
+				return 0.5 * slope * (overShoot + kneeHalf) * (overShoot + kneeHalf) / (double)s.knee;
+
+			return slope * overShoot;
+		}
+
+		// input and output may not alias; gainReductionDb, if given, receives the envelope per sample
+		void process(const float* const* input, double* const* output, int numChannels, int numSamples, double* gainReductionDb = nullptr)
+		{
+			const auto mix = (double)settings.mix;
+
+			for (int i = 0; i < numSamples; ++i)
+			{
+				auto peak = 0.0;
+
+				for (int channel = 0; channel < numChannels; ++channel)
+					peak = std::max(peak, std::abs((double)input[channel][i]));
+
+				const auto levelDb = peak > 0.0 ? std::max(20.0 * std::log10(peak), floorDecibels) : floorDecibels;
+				const auto target = getGainDecibels(settings, levelDb);
+				const auto difference = target - envelope;
+
+				envelope += (difference < 0.0 ? attackCoefficient : releaseCoefficient) * difference;
+
+				if (gainReductionDb != nullptr)
+					gainReductionDb[i] = envelope;
+
+				const auto factor = 1.0 - mix + mix * std::pow(10.0, (envelope + (double)settings.gain) / 20.0);
+
+				for (int channel = 0; channel < numChannels; ++channel)
+					output[channel][i] = (double)input[channel][i] * factor;
+			}
+		}
+
+		double getEnvelopeDecibels() const { return envelope; }
+
+	private:
+		double getSmoothingCoefficient(float timeMs) const
+		{
+			const auto samples = (double)timeMs * 0.001 * sampleRate;
+			return samples > 0.0 ? 1.0 - std::exp(-1.0 / samples) : 1.0;
+		}
+
+		ChainSettings settings;
+		double sampleRate{ 44100.0 };
+		double attackCoefficient{}, releaseCoefficient{};
+		double envelope{};
+	};
+}
@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+	Hands immutable snapshots from one writer thread to the audio thread,
+	JUCE-free.
+
+	The writer allocates a snapshot and publishes it with one atomic pointer
+	exchange. The reader picks it up with another and keeps using it until
+	the next one arrives; the snapshot it replaces goes back to the writer
+	through a small single-producer ring, to be deleted on the writer's
+	thread the next time it publishes or collects. The reader never locks,
+	allocates or frees.
+
+	A snapshot the reader never got to see (two publishes in a row) is
+	deleted by the writer straight away, since the reader can't hold it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <memory>
+
+namespace Dsp
+{
+	template <typename Snapshot>
+	class SnapshotExchange
+	{
+	public:
+		SnapshotExchange() = default;
+		SnapshotExchange(const SnapshotExchange&) = delete;
+		SnapshotExchange& operator=(const SnapshotExchange&) = delete;
+
+		~SnapshotExchange()
+		{
+			collectGarbage();
+			delete pending.exchange(nullptr);
+			delete current;
+		}
+
+		// Writer thread
+		void publish(std::unique_ptr<const Snapshot> snapshot)
+		{
+			collectGarbage();
+			delete pending.exchange(snapshot.release(), std::memory_order_acq_rel);
+		}
+
+		// Writer thread: deletes the snapshots the reader has finished with
+		void collectGarbage()
+		{
+			auto read = retiredRead.load(std::memory_order_relaxed);
+			const auto written = retiredWrite.load(std::memory_order_acquire);
+
+			for (; read != written; read = (read + 1) % retired.size())
+				delete retired[read];
+
+			retiredRead.store(read, std::memory_order_release);
+		}
+
+		// Reader thread: the snapshot published since the last call, or nullptr if there is none.
+		// It stays valid until the next call that returns non-null.
+		const Snapshot* acquireNew() noexcept
+		{
+			auto* next = pending.exchange(nullptr, std::memory_order_acq_rel);
+
+			if (next == nullptr)
+				return nullptr;
+
+			retire(current);
+			current = next;
+			return current;
+		}
+
+		// Reader thread: the latest snapshot acquired, nullptr before the first one
+		const Snapshot* getCurrent() const noexcept { return current; }
+
+	private:
+		void retire(const Snapshot* snapshot) noexcept
+		{
+			if (snapshot == nullptr)
+				return;
+
+			const auto write = retiredWrite.load(std::memory_order_relaxed);
+			const auto next = (write + 1) % retired.size();
+
+			// Full means the writer hasn't collected in a long time; leaking beats freeing here
+			if (next == retiredRead.load(std::memory_order_acquire))
+			{
+				assert(false);
+				return;
+			}
+
+			retired[write] = snapshot;
+			retiredWrite.store(next, std::memory_order_release);
+		}
+
+		std::atomic<const Snapshot*> pending{};
+		const Snapshot* current{};
+
+		std::array<const Snapshot*, 32> retired{};
+		std::atomic<size_t> retiredWrite{}, retiredRead{};
+	};
+}
@@ -0,0 +1,257 @@
+/*
+  ==============================================================================
+
+	Cycle-counter timing of the processing stages.
+
+	The audio thread records one value per stage per block into a lock-free
+	histogram; any other thread can read percentiles from it. When profiling
+	is switched off at runtime a ScopedTimer costs one relaxed atomic load,
+	and building with COMPRESSORV2_PROFILING=0 removes it entirely, along
+	with the stage boundaries reported to an Observer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+ #include <intrin.h>
+ #define COMPRESSORV2_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+ #include <x86intrin.h>
+ #define COMPRESSORV2_HAS_RDTSC 1
+#else
+ #define COMPRESSORV2_HAS_RDTSC 0
+#endif
+
+#ifndef COMPRESSORV2_PROFILING
+ #define COMPRESSORV2_PROFILING 1
+#endif
+
+namespace Dsp
+{
+	enum class Stage
+	{
+		block,
+		detector,
+		gainComputer,
+		mix,
+		metering,
+		numStages
+	};
+
+	// Returns a string literal, safe to keep the pointer
+	inline const char* getStageName(Stage stage)
+	{
+		switch (stage)
+		{
+			case Stage::block:        return "block";
+			case Stage::detector:     return "detector";
+			case Stage::gainComputer: return "gain computer";
+			case Stage::mix:          return "mix";
+			case Stage::metering:     return "metering";
+			default:                  return "";
+		}
+	}
+
+	struct StageStats
+	{
+		float p50{}, p99{}, max{};
+		std::uint32_t count{};
+	};
+
+	// Log-spaced histogram of ns/sample, eight buckets per octave from 1/64 ns to 16 us.
+	// Written by one thread, read by any.
+	class TimingHistogram
+	{
+	public:
+		static constexpr int bucketsPerOctave{ 8 };
+		static constexpr int minOctave{ -6 };
+		static constexpr int numBuckets{ 20 * bucketsPerOctave };
+
+		void add(float nsPerSample) noexcept
+		{
+			auto bucket = nsPerSample > 0.f ? (int)((std::log2(nsPerSample) - (float)minOctave) * (float)bucketsPerOctave) : 0;
+			bucket = std::clamp(bucket, 0, numBuckets - 1);
+
+			buckets[(size_t)bucket].fetch_add(1, std::memory_order_relaxed);
+
+			if (nsPerSample > maximum.load(std::memory_order_relaxed))
+				maximum.store(nsPerSample, std::memory_order_relaxed);
+		}
+
+		StageStats getStats() const noexcept
+		{
+			std::array<std::uint32_t, numBuckets> counts;
+			std::uint32_t total{};
+
+			for (size_t i = 0; i < counts.size(); ++i)
+			{
+				counts[i] = buckets[i].load(std::memory_order_relaxed);
+				total += counts[i];
+			}
+
+			StageStats stats;
+			stats.count = total;
+			stats.p50 = getPercentile(counts, total, 0.5f);
+			stats.p99 = getPercentile(counts, total, 0.99f);
+			stats.max = maximum.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		void reset() noexcept
+		{
+			for (auto& bucket : buckets)
+				bucket.store(0, std::memory_order_relaxed);
+
+			maximum.store(0.f, std::memory_order_relaxed);
+		}
+
+	private:
+		static float getBucketValue(int bucket) noexcept
+		{
+			// Geometric centre of the bucket
+			return std::exp2(((float)bucket + 0.5f) / (float)bucketsPerOctave + (float)minOctave);
+		}
+
+		static float getPercentile(const std::array<std::uint32_t, numBuckets>& counts, std::uint32_t total, float percentile) noexcept
+		{
+			if (total == 0)
+				return 0.f;
+
+			const auto target = (std::uint32_t)std::ceil(percentile * (float)total);
+			std::uint32_t seen{};
+
+			for (int i = 0; i < numBuckets; ++i)
+			{
+				seen += counts[(size_t)i];
+
+				if (seen >= target)
+					return getBucketValue(i);
+			}
+
+			return getBucketValue(numBuckets - 1);
+		}
+
+		std::array<std::atomic<std::uint32_t>, numBuckets> buckets{};
+		std::atomic<float> maximum{};
+	};
+
+	class StageProfiler
+	{
+	public:
+		// Told about stage boundaries on the audio thread, e.g. to put them on a trace timeline
+		struct Observer
+		{
+			virtual ~Observer() = default;
+			virtual bool isObserving() const noexcept = 0;
+			virtual void stageBoundary(Stage stage, bool began) noexcept = 0;
+		};
+
+		static std::uint64_t readCycleCounter() noexcept
+		{
+		   #if COMPRESSORV2_HAS_RDTSC
+			return __rdtsc();
+		   #else
+			return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		   #endif
+		}
+
+		// Call from a non-realtime thread; the first call calibrates the cycle counter.
+		void setEnabled(bool shouldBeEnabled)
+		{
+			if (shouldBeEnabled)
+				nanosecondsPerCycle.store(calibrate(), std::memory_order_relaxed);
+
+			enabled.store(shouldBeEnabled, std::memory_order_relaxed);
+		}
+
+		bool isEnabled() const noexcept { return enabled.load(std::memory_order_relaxed); }
+
+		// Set before processing starts; the observer must outlive the profiler's use
+		void setObserver(Observer* newObserver) noexcept { observer = newObserver; }
+
+		void record(Stage stage, std::uint64_t cycles, int numSamples) noexcept
+		{
+			if (numSamples > 0)
+			{
+				const auto ns = (float)((double)cycles * nanosecondsPerCycle.load(std::memory_order_relaxed));
+				histograms[(size_t)stage].add(ns / (float)numSamples);
+			}
+		}
+
+		StageStats getStats(Stage stage) const noexcept { return histograms[(size_t)stage].getStats(); }
+
+		void reset() noexcept
+		{
+			for (auto& histogram : histograms)
+				histogram.reset();
+		}
+
+		class ScopedTimer
+		{
+		public:
+		   #if COMPRESSORV2_PROFILING
+			ScopedTimer(StageProfiler* p, Stage s, int n) noexcept
+				: profiler(p != nullptr && p->isEnabled() ? p : nullptr),
+				observer(p != nullptr && p->observer != nullptr && p->observer->isObserving() ? p->observer : nullptr),
+				stage(s), numSamples(n), start(profiler != nullptr ? readCycleCounter() : 0)
+			{
+				if (observer != nullptr)
+					observer->stageBoundary(stage, true);
+			}
+
+			~ScopedTimer()
+			{
+				if (profiler != nullptr)
+					profiler->record(stage, readCycleCounter() - start, numSamples);
+
+				if (observer != nullptr)
+					observer->stageBoundary(stage, false);
+			}
+
+		private:
+			StageProfiler* profiler;
+			Observer* observer;
+			Stage stage;
+			int numSamples;
+			std::uint64_t start;
+		   #else
+			ScopedTimer(StageProfiler*, Stage, int) noexcept {}
+		   #endif
+		};
+
+	private:
+		static double calibrate()
+		{
+		   #if COMPRESSORV2_HAS_RDTSC
+			static const double calibrated = []
+			{
+				const auto startTime = std::chrono::steady_clock::now();
+				const auto startCycles = readCycleCounter();
+
+				while (std::chrono::steady_clock::now() - startTime < std::chrono::milliseconds(5)) {}
+
+				const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+				return elapsed / (double)(readCycleCounter() - startCycles);
+			}();
+
+			return calibrated;
+		   #else
+			return 1.0;
+		   #endif
+		}
+
+		std::atomic<bool> enabled{};
+		std::atomic<double> nanosecondsPerCycle{ 1.0 };
+		Observer* observer{};
+		std::array<TimingHistogram, (size_t)Stage::numStages> histograms;
+	};
+}
@@ -61,6 +61,64 @@ CompressorV2AudioProcessorEditor::CompressorV2AudioProcessorEditor(CompressorV2A
 	addAndMakeVisible(mixLabel);
 	addAndMakeVisible(gainLabel);
 
+	profilerButton.setClickingTogglesState(true);
+	profilerButton.setToggleState(audioProcessor.isProfilingEnabled(), juce::NotificationType::dontSendNotification);
+	profilerButton.onClick = [this]
+	{
+		audioProcessor.setProfilingEnabled(profilerButton.getToggleState());
+		profilerOverlay.setVisible(profilerButton.getToggleState());
+	};
+	addAndMakeVisible(profilerButton);
+
+	profilerOverlay.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 11.f, juce::Font::plain));
+	profilerOverlay.setJustificationType(juce::Justification::topLeft);
+	profilerOverlay.setColour(juce::Label::backgroundColourId, juce::Colours::black.withAlpha(0.6f));
+	profilerOverlay.setInterceptsMouseClicks(false, false);
+	addChildComponent(profilerOverlay);
+	profilerOverlay.setVisible(audioProcessor.isProfilingEnabled());
+
+	for (int slot = 0; slot < (int)presetSlotButtons.size(); ++slot)
+	{
+		auto& button = presetSlotButtons[(size_t)slot];
+		button.setButtonText(juce::String::charToString((juce::juce_wchar)('A' + slot)));
+		button.setTooltip("Click to recall, shift-click to store");
+		button.onClick = [this, slot]
+		{
+			if (juce::ModifierKeys::currentModifiers.isShiftDown())
+				audioProcessor.storePresetSlot(slot);
+			else
+				audioProcessor.recallPresetSlot(slot);
+
+			updatePresetSlotButtons();
+		};
+		addAndMakeVisible(button);
+	}
+
+	updatePresetSlotButtons();
+
+	// Items have to be there before the attachment syncs the selection
+	ecoBox.addItemList(audioProcessor.apvts.getParameter("Eco")->getAllValueStrings(), 1);
+	ecoBox.setTooltip("Eco: samples per gain computation");
+	ecoAttachment = std::make_unique<APVTS::ComboBoxAttachment>(audioProcessor.apvts, "Eco", ecoBox);
+	addAndMakeVisible(ecoBox);
+
+	adaptiveButton.setTooltip("Step Eco up while the CPU can't keep up");
+	addAndMakeVisible(adaptiveButton);
+
+	autoMakeupBox.addItemList(audioProcessor.apvts.getParameter("AutoMakeup")->getAllValueStrings(), 1);
+	autoMakeupBox.setTooltip("Auto makeup on top of Gain: from the curve, or from the running gain reduction");
+	autoMakeupAttachment = std::make_unique<APVTS::ComboBoxAttachment>(audioProcessor.apvts, "AutoMakeup", autoMakeupBox);
+	addAndMakeVisible(autoMakeupBox);
+
+	loudnessLabel.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 11.f, juce::Font::plain));
+	loudnessLabel.setJustificationType(juce::Justification::topLeft);
+	loudnessLabel.setColour(juce::Label::backgroundColourId, juce::Colours::black.withAlpha(0.4f));
+	loudnessLabel.setInterceptsMouseClicks(false, false);
+	addAndMakeVisible(loudnessLabel);
+
+	loudnessResetButton.setTooltip("Restart integrated loudness and loudness range");
+	loudnessResetButton.onClick = [this] { audioProcessor.resetLoudness(); };
+	addAndMakeVisible(loudnessResetButton);
 
 	for (auto* comp : getComps())
 	{
@@ -77,6 +135,8 @@ CompressorV2AudioProcessorEditor::~CompressorV2AudioProcessorEditor()
 //==============================================================================
 void CompressorV2AudioProcessorEditor::paint(juce::Graphics& g)
 {
+	auto trace = audioProcessor.traceScope("editor paint");
+
 	g.fillAll(juce::Colours::darkblue.withBrightness(0.1f));
 
 	audioProcessor.waveViewerCompressed.setColours(juce::Colours::darkslateblue, juce::Colours::seagreen);
@@ -175,21 +235,130 @@ void CompressorV2AudioProcessorEditor::resized()
 
 	juce::Rectangle<int> sliderLineArea(juce::Point<int>(originalPosition - 2.5f, 0), juce::Point <int>(originalPosition + 2.5f, heightWaveForm));
 	sliderLine.setBounds(sliderLineArea);
+
+	//profiler overlay
+	profilerButton.setBounds(105, 5, 40, 20);
+	profilerOverlay.setBounds(105, 30, 330, 146);
+	profilerButton.toFront(false);
+	profilerOverlay.toFront(false);
+
+	for (int slot = 0; slot < (int)presetSlotButtons.size(); ++slot)
+		presetSlotButtons[(size_t)slot].setBounds(150 + slot * 25, 5, 24, 20);
+
+	ecoBox.setBounds(255, 5, 60, 20);
+	autoMakeupBox.setBounds(760, 282, 70, 16);
+	adaptiveButton.setBounds(320, 5, 55, 20);
+
+	loudnessLabel.setBounds(380, 5, 460, 30);
+	loudnessResetButton.setBounds(845, 5, 50, 20);
 }
 
 void CompressorV2AudioProcessorEditor::timerCallback()
 {
-	outputMeterLeft.setLevel(audioProcessor.getRMSValueOutput(0));
+	auto trace = audioProcessor.traceScope("editor timerCallback");
+
+	auto elapsedSeconds = (float)getTimerInterval() * 0.001f;
+	auto numChannels = audioProcessor.getNumMeterChannels();
+
+	for (int channel = 0; channel < 2; ++channel)
+	{
+		if (channel < numChannels)
+		{
+			auto reading = audioProcessor.takeMeterReading(channel);
+			inputBallistics[channel].update(reading.inputPeak, reading.getInputRms(), elapsedSeconds);
+			outputBallistics[channel].update(reading.outputPeak, reading.getOutputRms(), elapsedSeconds);
+		}
+		else if (channel > 0)
+		{
+			// Mono: both meters show the one channel
+			inputBallistics[channel] = inputBallistics[0];
+			outputBallistics[channel] = outputBallistics[0];
+		}
+	}
+
+	outputMeterLeft.setLevel(outputBallistics[0].getRmsDecibels());
 	outputMeterLeft.repaint();
 
-	outputMeterRight.setLevel(audioProcessor.getRMSValueOutput(1));
+	outputMeterRight.setLevel(outputBallistics[1].getRmsDecibels());
 	outputMeterRight.repaint();
 
-	inputMeterLeft.setLevel(audioProcessor.getRMSValueInput(0));
+	inputMeterLeft.setLevel(inputBallistics[0].getRmsDecibels());
 	inputMeterLeft.repaint();
 
-	inputMeterRight.setLevel(audioProcessor.getRMSValueInput(1));
+	inputMeterRight.setLevel(inputBallistics[1].getRmsDecibels());
 	inputMeterRight.repaint();
+
+	if (profilerOverlay.isVisible())
+	{
+		updateProfilerOverlay();
+	}
+
+	// A state load can change the slots while the editor is open
+	updatePresetSlotButtons();
+	updateLoudnessLabel();
+}
+
+void CompressorV2AudioProcessorEditor::updatePresetSlotButtons()
+{
+	for (int slot = 0; slot < (int)presetSlotButtons.size(); ++slot)
+	{
+		auto& button = presetSlotButtons[(size_t)slot];
+		button.setToggleState(slot == audioProcessor.getActivePresetSlot(), juce::NotificationType::dontSendNotification);
+		button.setAlpha(audioProcessor.isPresetSlotStored(slot) ? 1.f : 0.5f);
+	}
+}
+
+void CompressorV2AudioProcessorEditor::updateLoudnessLabel()
+{
+	const auto format = [](float lufs) { return (lufs > -100.f ? juce::String(lufs, 1) : juce::String("-inf")).paddedLeft(' ', 6); };
+
+	const auto line = [&](const char* name, const LoudnessAnalysis::Reading& reading)
+	{
+		// A gap in the steps leaves integrated and range short; say so rather than show them as if whole
+		return juce::String(name) + "  M " + format(reading.momentary) + "  S " + format(reading.shortTerm)
+			+ "  I " + format(reading.integrated) + " LUFS  LRA " + juce::String(reading.range, 1).paddedLeft(' ', 4) + " LU"
+			+ (reading.complete ? "" : "  (gap, reset)");
+	};
+
+	loudnessLabel.setText(line("in ", audioProcessor.getInputLoudness()) + "\n" + line("out", audioProcessor.getOutputLoudness()),
+		juce::NotificationType::dontSendNotification);
+}
+
+void CompressorV2AudioProcessorEditor::updateProfilerOverlay()
+{
+	juce::String text("stage          p50     p99     max  ns/sample\n");
+
+	for (int i = 0; i < (int)Dsp::Stage::numStages; ++i)
+	{
+		auto stage = (Dsp::Stage)i;
+		auto stats = audioProcessor.getStageStats(stage);
+
+		text << juce::String(Dsp::getStageName(stage)).paddedRight(' ', 14)
+			<< juce::String(stats.p50, 2).paddedLeft(' ', 6) << " "
+			<< juce::String(stats.p99, 2).paddedLeft(' ', 7) << " "
+			<< juce::String(stats.max, 2).paddedLeft(' ', 7) << "\n";
+	}
+
+	auto paths = audioProcessor.getPathCounts();
+	text << "blocks  silent " << juce::String((juce::int64)paths.silent)
+		<< "  quiet " << juce::String((juce::int64)paths.belowThreshold)
+		<< "  full " << juce::String((juce::int64)paths.full) << "\n";
+
+	// Not reset with the profiler: any at all is worth knowing about
+	auto faults = audioProcessor.getFaultCounts();
+	text << "faults  nan/inf " << juce::String((juce::int64)faults.nonFiniteSamples)
+		<< "  state resets " << juce::String((juce::int64)faults.stateResets) << "\n";
+
+	text << "quality " << CompressorV2AudioProcessor::getQualityName(audioProcessor.getQualityLevel())
+		<< (audioProcessor.apvts.getRawParameterValue("Adaptive")->load() > 0.5f ? " (adaptive)" : "")
+		<< "  downgrades " << juce::String((juce::int64)audioProcessor.getQualityDowngrades()) << "\n";
+
+	const auto& histogram = audioProcessor.getGainReductionHistogram();
+	text << "gr p50 " << juce::String(histogram.getPercentile(0.5f), 0) << " dB  p95 " << juce::String(histogram.getPercentile(0.95f), 0)
+		<< " dB  dropped " << juce::String((juce::int64)audioProcessor.getDroppedAnalysisBlocks())
+		<< "  loudness " << juce::String((juce::int64)audioProcessor.getDroppedLoudnessSteps()) << "\n";
+
+	profilerOverlay.setText(text, juce::NotificationType::dontSendNotification);
 }
 
 
@@ -233,6 +402,31 @@ void CompressorV2AudioProcessorEditor::mouseDown(const juce::MouseEvent& event)
 	}
 }
 
+const TextLayoutCache::Entry& TextLayoutCache::get(const juce::String& text)
+{
+	if (!entries.contains(text))
+	{
+		if (entries.size() >= maxEntries)
+		{
+			entries.clear();
+		}
+
+		Entry entry;
+		entry.glyphs.addLineOfText(font, text, 0.f, 0.f);
+		entry.width = font.getStringWidthFloat(text);
+		entries.set(text, entry);
+	}
+
+	return entries.getReference(text);
+}
+
+void TextLayoutCache::drawCentred(juce::Graphics& g, const juce::String& text, juce::Point<float> centre)
+{
+	auto& entry = get(text);
+	auto baseline = centre.getY() + (font.getAscent() - font.getDescent()) * 0.5f;
+	entry.glyphs.draw(g, juce::AffineTransform::translation(centre.getX() - entry.width * 0.5f, baseline));
+}
+
 void LookAndFeel::drawRotarySlider(juce::Graphics& g, int x, int y, int width, int height,
 	float sliderPosProportional, float rotaryStartAngle,
 	float rotaryEndAngle, juce::Slider& slider)
@@ -240,39 +434,28 @@ void LookAndFeel::drawRotarySlider(juce::Graphics& g, int x, int y, int width, i
 	using namespace juce;
 
 	auto bounds = Rectangle<float>(x, y, width, height);
-	g.setColour(juce::Colours::deeppink.withBrightness(0.5f));
-	g.fillEllipse(bounds);
+	auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+	auto knob = resources->getKnobImage(width, scale);
+	g.drawImage(knob, Rectangle<float>(x - 1, y - 1, width + 2, width + 2));
 
 	g.setColour(juce::Colours::ghostwhite);
-	g.drawEllipse(bounds, 2.f);
 
 	if (auto* rswl = dynamic_cast<CustomRotarySlider*>(&slider))
 	{
 		auto center = bounds.getCentre();
 
-		Path path;
-		Rectangle<float> r;
-		r.setLeft(center.getX() - 2);
-		r.setRight(center.getX() + 2);
-		r.setTop(bounds.getY());
-		r.setBottom(center.getY() - rswl->getTextHeight() * 1.5);
-
-		path.addRoundedRectangle(r, 2.f);
-
 		auto sliderAngleRad = jmap(sliderPosProportional, 0.f, 0.1f, rotaryStartAngle, rotaryEndAngle);
-		path.applyTransform(AffineTransform().rotated(sliderAngleRad, center.getX(), center.getY()));
-		g.fillPath(path);
+		g.fillPath(rswl->getPointerPath(), AffineTransform::rotation(sliderAngleRad, center.getX(), center.getY()));
 
-		g.setFont(rswl->getTextHeight());
 		auto text = rswl->getValueString();
-		auto strWidth = g.getCurrentFont().getStringWidth(text);
-		r.setSize(strWidth + 4, rswl->getTextHeight() + 2);
+		Rectangle<float> r;
+		r.setSize(textLayouts.getWidth(text) + 4, rswl->getTextHeight() + 2);
 		r.setCentre(center);
 		g.setColour(Colours::black);
 		g.fillRect(r);
-		
+
 		g.setColour(Colours::white);
-		g.drawFittedText(text, r.toNearestInt(), juce::Justification::centred, 1);
+		textLayouts.drawCentred(g, text, center);
 	}
 }
 
@@ -293,36 +476,49 @@ void CustomRotarySlider::paint(juce::Graphics& g)
 {
 	using namespace juce;
 
-	auto startAngle = degreesToRadians(180.f + 45.f);
-	auto endAngle = degreesToRadians(180.f) + MathConstants<float>::twoPi;
 	auto range = getRange();
-
 	auto sliderBounds = getSliderBounds();
-	
+
 	getLookAndFeel().drawRotarySlider(g, sliderBounds.getX(), sliderBounds.getY(), sliderBounds.getWidth(), sliderBounds.getHeight(),
-										jmap(getValue(), range.getStart(), range.getEnd(), 0.0, 1.0), startAngle, endAngle, *this);
+										jmap(getValue(), range.getStart(), range.getEnd(), 0.0, 1.0), getStartAngle(), getEndAngle(), *this);
 
-	auto center = sliderBounds.toFloat().getCentre();
-	auto radius = sliderBounds.getWidth() * 0.5f;
 	g.setColour(juce::Colours::ghostwhite);
-	g.setFont(getTextHeight());
-	auto numChoices = labels.size();
 
-	for (int i = 0; i < numChoices; ++i)
+	for (int i = 0; i < labels.size() && i < labelCentres.size(); ++i)
 	{
-		auto pos = labels[i].pos;
-		jassert(0.f <= pos);
-		jassert(pos <= 1.f);
+		lookAndFeel->textLayouts.drawCentred(g, labels[i].label, labelCentres[i]);
+	}
+}
 
-		auto angle = jmap(pos, 0.f, 1.f, startAngle, endAngle - degreesToRadians(45.f));
-		auto c = center.getPointOnCircumference(radius + getTextHeight() * 0.5f + 1, angle);
-		Rectangle<float> r;
-		auto str = labels[i].label;
-		r.setSize(g.getCurrentFont().getStringWidth(str), getTextHeight());
-		r.setCentre(c);
-		r.setY(r.getY() + getTextHeight());
+void CustomRotarySlider::resized()
+{
+	using namespace juce;
+
+	Slider::resized();
+
+	auto sliderBounds = getSliderBounds().toFloat();
+	auto center = sliderBounds.getCentre();
+	auto radius = sliderBounds.getWidth() * 0.5f;
+
+	Rectangle<float> r;
+	r.setLeft(center.getX() - 2);
+	r.setRight(center.getX() + 2);
+	r.setTop(sliderBounds.getY());
+	r.setBottom(center.getY() - getTextHeight() * 1.5);
 
-		g.drawFittedText(str, r.toNearestInt(), juce::Justification::centred, 1);
+	pointerPath.clear();
+	pointerPath.addRoundedRectangle(r, 2.f);
+
+	labelCentres.clearQuick();
+
+	for (auto& label : labels)
+	{
+		jassert(0.f <= label.pos);
+		jassert(label.pos <= 1.f);
+
+		auto angle = jmap(label.pos, 0.f, 1.f, getStartAngle(), getEndAngle() - degreesToRadians(45.f));
+		auto c = center.getPointOnCircumference(radius + getTextHeight() * 0.5f + 1, angle);
+		labelCentres.add(c.translated(0.f, (float)getTextHeight()));
 	}
 }
 
@@ -10,13 +10,39 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "SharedResources.h"
 #include "C:\Users\kaatj\OneDrive\Bureaublad\Audio Prog\JUCE\CompressorV2\Builds\VisualStudio2022\Levelmeter.h"
 #include "C:\Users\kaatj\OneDrive\Bureaublad\Audio Prog\JUCE\CompressorV2\Builds\VisualStudio2022\SliderButton.h"
+struct TextLayoutCache
+{
+	struct Entry
+	{
+		juce::GlyphArrangement glyphs;
+		float width{};
+	};
+
+	explicit TextLayoutCache(const juce::Font& textFont) : font(textFont) {}
+
+	const Entry& get(const juce::String& text);
+	void drawCentred(juce::Graphics& g, const juce::String& text, juce::Point<float> centre);
+	float getWidth(const juce::String& text) { return get(text).width; }
+
+private:
+	// Slider values are quantised by their interval, so this only ever holds a few hundred strings
+	static constexpr int maxEntries{ 1024 };
+
+	juce::Font font;
+	juce::HashMap<juce::String, Entry> entries;
+};
+
 struct LookAndFeel : juce::LookAndFeel_V4
 {
 	void drawRotarySlider(juce::Graphics& g, int x, int y, int width, int height,
 		float sliderPosProportional, float rotaryStartAngle,
 		float rotaryEndAngle, juce::Slider& slider) override;
+
+	juce::SharedResourcePointer<SharedResources> resources;
+	TextLayoutCache textLayouts{ resources->getFont(14.f) };
 };
 
 struct CustomRotarySlider : juce::Slider
@@ -27,7 +53,7 @@ struct CustomRotarySlider : juce::Slider
 		param(&param),
 		suffix(unitSuffix)
 	{
-		setLookAndFeel(&instance);
+		setLookAndFeel(lookAndFeel.get());
 	}
 
 	struct LabelPos
@@ -44,13 +70,22 @@ struct CustomRotarySlider : juce::Slider
 	}
 
 	void paint(juce::Graphics& g) override;
+	void resized() override;
 	juce::Rectangle<int> getSliderBounds() const;
 	int getTextHeight() const { return 14; };
 	juce::String getValueString() const;
+	const juce::Path& getPointerPath() const { return pointerPath; }
+
+	static float getStartAngle() { return juce::degreesToRadians(180.f + 45.f); }
+	static float getEndAngle() { return juce::degreesToRadians(180.f) + juce::MathConstants<float>::twoPi; }
 private:
-	LookAndFeel instance;
+	juce::SharedResourcePointer<LookAndFeel> lookAndFeel;
 	juce::RangedAudioParameter* param;
 	juce::String suffix;
+
+	// Rebuilt in resized(); paint only transforms and draws them
+	juce::Path pointerPath;
+	juce::Array<juce::Point<float>> labelCentres;
 };
 //==============================================================================
 /**
@@ -68,20 +103,35 @@ public:
 	void mouseDrag(const juce::MouseEvent& event) override;
 	void mouseDown(const juce::MouseEvent& event) override;
 	void setLabels();
+	void updateProfilerOverlay();
+	void updatePresetSlotButtons();
+	void updateLoudnessLabel();
 
 private:
 	CompressorV2AudioProcessor& audioProcessor;
 
 	Gui::LevelMeter outputMeterLeft, outputMeterRight{};
 	Gui::LevelMeter inputMeterLeft, inputMeterRight{};
+	Dsp::MeterBallistics inputBallistics[2], outputBallistics[2];
 	Gui::SliderButton sliderButton;
 	Gui::SliderButton sliderLine;
 	juce::Label thresholdLabel, kneeLabel, ratioLabel, attackLabel, releaseLabel, mixLabel, gainLabel;
+	juce::TextButton profilerButton{ "DSP" };
+	juce::Label profilerOverlay;
+	// Click recalls a slot, shift-click stores the current settings in it
+	std::array<juce::TextButton, CompressorV2AudioProcessor::numPresetSlots> presetSlotButtons;
+	juce::ComboBox ecoBox;
+	juce::ToggleButton adaptiveButton{ "Auto" };
+	juce::ComboBox autoMakeupBox;
+	juce::Label loudnessLabel;
+	juce::TextButton loudnessResetButton{ "Reset" };
 
 	CustomRotarySlider thresholdSlider, kneeSlider, ratioSlider, attackSlider, releaseSlider, mixSlider, gainSlider;
 	std::vector<juce::Component*> getComps();
 	using APVTS = juce::AudioProcessorValueTreeState;
 	APVTS::SliderAttachment thresholdSliderAttachment, kneeSliderAttachment, ratioSliderAttachment, attackSliderAttachment, releaseSliderAttachment, mixSliderAttachment, gainSliderAttachment;
+	std::unique_ptr<APVTS::ComboBoxAttachment> ecoAttachment, autoMakeupAttachment;
+	APVTS::ButtonAttachment adaptiveAttachment{ audioProcessor.apvts, "Adaptive", adaptiveButton };
 
 	int originalPosition{ 450 };
 	int minPositionWaveForm{ 100 };
@@ -7,8 +7,21 @@
 */
 
 #include "PluginProcessor.h"
+#if ! COMPRESSORV2_HEADLESS
 #include "PluginEditor.h"
+#endif
+#if JucePlugin_Enable_ARA
+#include "AraRenderer.h"
+#endif
+
+static std::atomic<int> numLiveInstances{};
+static std::atomic<int> nextInstanceId{ 1 };
 
+const char* const CompressorV2AudioProcessor::stateParameterIds[] { "Threshold", "Knee", "Ratio", "Attack", "Release", "Gain", "Mix", "Morph", "Eco", "Adaptive", "AutoMakeup" };
+
+// ChainSettings fields in state order
+static constexpr float ChainSettings::* chainFields[] { &ChainSettings::threshold, &ChainSettings::knee, &ChainSettings::ratio,
+	&ChainSettings::attack, &ChainSettings::release, &ChainSettings::gain, &ChainSettings::mix };
 
 //==============================================================================
 CompressorV2AudioProcessor::CompressorV2AudioProcessor()
@@ -20,7 +33,7 @@ CompressorV2AudioProcessor::CompressorV2AudioProcessor()
 #endif
 		.withOutput("Output", juce::AudioChannelSet::stereo(), true)
 #endif
-	), waveViewerCompressed(1), waveViewerUncompressed(1)
+	), waveViewerCompressed(1), waveViewerUncompressed(1), instanceId(nextInstanceId++)
 #endif
 {
 	waveViewerCompressed.setRepaintRate(30);
@@ -36,11 +49,56 @@ CompressorV2AudioProcessor::CompressorV2AudioProcessor()
 	release = dynamic_cast<juce::AudioParameterFloat*>(apvts.getParameter("Release"));
 	gain = dynamic_cast<juce::AudioParameterFloat*>(apvts.getParameter("Gain"));
 	dryWetMix = dynamic_cast<juce::AudioParameterFloat*>(apvts.getParameter("Mix"));
+	morphTime = dynamic_cast<juce::AudioParameterFloat*>(apvts.getParameter("Morph"));
+	eco = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("Eco"));
+	adaptive = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("Adaptive"));
+	autoMakeup = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("AutoMakeup"));
+
+	for (int i = 0; i < numStateParameters; ++i)
+	{
+		stateParameters[(size_t)i] = dynamic_cast<juce::RangedAudioParameter*>(apvts.getParameter(stateParameterIds[i]));
+		jassert(stateParameters[(size_t)i] != nullptr);
+	}
+
+	static_assert(std::size(chainFields) == numChainParameters);
+	targetSettings = parameterBaseline = getCurrentSettings();
+
+	compressor.setProfiler(&profiler);
+	profiler.setObserver(&traceObserver);
+
+	auto histogram = std::make_unique<GainReductionHistogram>();
+	gainReductionHistogram = histogram.get();
+	analysis->addAnalysis(std::move(histogram));
+
+	auto loudnessAnalysis = std::make_unique<LoudnessAnalysis>();
+	loudness = loudnessAnalysis.get();
+	analysis->addAnalysis(std::move(loudnessAnalysis));
+	analysisWorker->addClient(analysis);
+
+	++numLiveInstances;
+
+	// Opt-in tracing for hosts where the API isn't reachable, e.g. COMPRESSORV2_TRACE=/tmp/compressor.json
+	auto tracePath = juce::SystemStats::getEnvironmentVariable("COMPRESSORV2_TRACE", {});
+
+	if (tracePath.isNotEmpty() && !tracer->isRecording())
+	{
+		tracer->start(juce::File::getCurrentWorkingDirectory().getChildFile(tracePath));
+	}
+
+	startTimerHz(10);
 }
 
 CompressorV2AudioProcessor::~CompressorV2AudioProcessor()
 {
+	stopTimer();
 
+#if JucePlugin_Enable_ARA
+	if (auto* renderer = getPlaybackRenderer<CompressorPlaybackRenderer>())
+		renderer->setSettingsSource({});
+#endif
+
+	analysisWorker->removeClient(analysis.get());
+	--numLiveInstances;
 }
 
 //==============================================================================
@@ -108,17 +166,57 @@ void CompressorV2AudioProcessor::changeProgramName(int index, const juce::String
 //==============================================================================
 void CompressorV2AudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-	juce::dsp::ProcessSpec spec{};
-	spec.maximumBlockSize = samplesPerBlock;
-	spec.numChannels = getTotalNumOutputChannels();
-	spec.sampleRate = sampleRate;
-	compressor.prepare(spec);
+	auto trace = traceScope("prepareToPlay");
+
+	adaptiveQuality.prepare(sampleRate);
+
+	updateCompressorSettings();
+	compressor.prepare(sampleRate, samplesPerBlock, getTotalNumOutputChannels());
+
+	viewerBuffer.setSize(2, samplesPerBlock);
+
+	// Room for the crossfade and whatever latency is reported, so bypass never allocates
+	bypassScratch.setSize(getTotalNumInputChannels(), samplesPerBlock);
+	dryDelay.setSize(getTotalNumInputChannels(), getLatencySamples());
+	dryDelay.clear();
+	dryDelayPosition = 0;
+	bypassFadeStep = (float)(1.0 / (bypassFadeSeconds * sampleRate));
+
+	analysis->prepare(sampleRate, getTotalNumOutputChannels());
+	inputLoudnessMeter.prepare(sampleRate, getTotalNumOutputChannels());
+	outputLoudnessMeter.prepare(sampleRate, getTotalNumOutputChannels());
+
+#if JucePlugin_Enable_ARA
+	prepareToPlayForARA(sampleRate, samplesPerBlock, getMainBusNumOutputChannels(), getProcessingPrecision());
+
+	if (auto* renderer = getPlaybackRenderer<CompressorPlaybackRenderer>())
+	{
+		// Double precision hosts get the ARA output through a float buffer
+		araBuffer.setSize(getMainBusNumOutputChannels(), samplesPerBlock);
+		renderer->setSettingsSource([this] { return getCurrentSettings(); });
+	}
+#endif
 }
 
 void CompressorV2AudioProcessor::releaseResources()
 {
-	// When playback stops, you can use this as an opportunity to free up any
-	// spare memory, etc.
+#if JucePlugin_Enable_ARA
+	releaseResourcesForARA();
+#endif
+}
+
+void CompressorV2AudioProcessor::reset()
+{
+	compressor.reset();
+
+	// A fade in flight ends where it was heading, and the latency line forgets the old audio
+	bypassMix = bypassed ? 1.f : 0.f;
+	dryDelay.clear();
+	dryDelayPosition = 0;
+
+	// A part-filled 100 ms step would otherwise mix audio from either side of the reset
+	inputLoudnessMeter.reset();
+	outputLoudnessMeter.reset();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -148,98 +246,383 @@ bool CompressorV2AudioProcessor::isBusesLayoutSupported(const BusesLayout& layou
 #endif
 
 void CompressorV2AudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+	processHostBlock(buffer, midiMessages);
+}
+
+void CompressorV2AudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+	processHostBlock(buffer, midiMessages);
+}
+
+template <typename SampleType>
+void CompressorV2AudioProcessor::processHostBlock(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midiMessages)
+{
+	// The deadline is the host block's, however many pieces the controllers cut it into, and the
+	// quality only changes between host blocks
+	const auto blockStart = std::chrono::steady_clock::now();
+	splitAtControllers(buffer, midiMessages, [this](auto& part) { processSamples(part); });
+	updateAdaptiveQuality(buffer.getNumSamples(), std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count());
+}
+
+void CompressorV2AudioProcessor::processBlockBypassed(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+	splitAtControllers(buffer, midiMessages, [this](auto& part) { bypassSamples(part); });
+}
+
+void CompressorV2AudioProcessor::processBlockBypassed(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+	splitAtControllers(buffer, midiMessages, [this](auto& part) { bypassSamples(part); });
+}
+
+int CompressorV2AudioProcessor::getMidiMappedIndex(const juce::MidiMessage& message) const noexcept
+{
+	if (!message.isController())
+		return -1;
+
+	const auto index = message.getControllerNumber() - firstMidiController;
+	return index >= 0 && index < numChainParameters ? index : -1;
+}
+
+template <typename SampleType, typename Render>
+void CompressorV2AudioProcessor::splitAtControllers(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midiMessages, Render&& render)
+{
+#if JucePlugin_Enable_ARA
+	// ARA playback renders from the play head's position, which only holds for the whole block
+	if (isBoundToARA())
+	{
+		render(buffer);
+		return;
+	}
+#endif
+
+	const auto numSamples = buffer.getNumSamples();
+	auto start = 0;
+
+	for (const auto metadata : midiMessages)
+	{
+		const auto message = metadata.getMessage();
+		const auto index = getMidiMappedIndex(message);
+
+		if (index < 0)
+			continue;
+
+		// Everything before the change runs on the old value; the settings are read again
+		// at the start of each sub-block, so the new one lands on this very sample. The morph
+		// it starts steps on the core's grid, which counts samples rather than blocks, so the
+		// result is the same at any buffer size.
+		const auto position = juce::jlimit(start, numSamples, metadata.samplePosition);
+
+		if (position > start)
+		{
+			// Refers to the host's channels, up to 32 of them without allocating
+			juce::AudioBuffer<SampleType> part(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, position - start);
+			render(part);
+			start = position;
+		}
+
+		// Straight into the target, as a recall does; the parameter is told on the message thread
+		const auto value = message.getControllerValue();
+		targetSettings.*chainFields[index] = stateParameters[(size_t)index]->convertFrom0to1((float)value / 127.f);
+		controllerValues[(size_t)index].store(value, std::memory_order_relaxed);
+		pendingControllers.fetch_or(1u << index);
+	}
+
+	if (start == 0)
+	{
+		render(buffer);
+	}
+	else if (start < numSamples)
+	{
+		juce::AudioBuffer<SampleType> part(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, numSamples - start);
+		render(part);
+	}
+}
+
+void CompressorV2AudioProcessor::updateCompressorSettings()
+{
+	compressor.setMorphTime(morphTime->get());
+	compressor.setControlInterval(getControlInterval());
+	compressor.setAutoMakeup((Dsp::AutoMakeup)autoMakeup->getIndex());
+	compressor.setParameters(updateTargetSettings());
+}
+
+template <typename SampleType>
+void CompressorV2AudioProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer)
 {
 	juce::ScopedNoDenormals noDenormals;
 	auto totalNumInputChannels = getTotalNumInputChannels();
 	auto totalNumOutputChannels = getTotalNumOutputChannels();
 	auto numSamples = buffer.getNumSamples();
 
-	juce::AudioBuffer<float> dryBuffer(totalNumInputChannels, numSamples);
-	juce::AudioBuffer<float> wetBuffer(totalNumInputChannels, numSamples);
+	Dsp::StageProfiler::ScopedTimer blockTimer(&profiler, Dsp::Stage::block, numSamples);
 
-	for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-		buffer.clear(i, 0, buffer.getNumSamples());
-
-	for (int channel = 0; channel < totalNumInputChannels; ++channel)
+#if JucePlugin_Enable_ARA
+	// Bound to ARA, the input is ignored and the clips play from their gain curves
+	if (auto* renderer = getPlaybackRenderer<CompressorPlaybackRenderer>())
 	{
-		channelData = buffer.getWritePointer(channel);
-		dryData = dryBuffer.getWritePointer(channel);
-		wetData = wetBuffer.getWritePointer(channel);
+		// Clips have no running estimate to go on, so both auto makeup modes use the curve's
+		auto araSettings = updateTargetSettings();
 
-		for (int sample = 0; sample < numSamples; ++sample)
+		if (autoMakeup->getIndex() != 0)
 		{
-			float level = std::abs(channelData[sample]);
-			dryData[sample] = channelData[sample];
+			Dsp::GainComputer curve;
+			curve.setParameters(araSettings.threshold, araSettings.knee, araSettings.ratio);
+			araSettings.gain -= curve.getGainDecibels(0.f);
+		}
 
-			if (level > inputLevel)
-			{
-				inputLevel = level;
-			}
+		renderer->setChainSettings(araSettings);
+		const auto realtime = isNonRealtime() ? Realtime::no : Realtime::yes;
 
-			float diff = overShoot - state;
+		if constexpr (std::is_same_v<SampleType, float>)
+		{
+			processBlockForARA(buffer, realtime, getPlayHead());
+		}
+		else
+		{
+			araBuffer.setSize(buffer.getNumChannels(), numSamples, false, false, true);
+			processBlockForARA(araBuffer, realtime, getPlayHead());
 
-			if (diff < 0.0f)
-			{
-				state += attack->get() * diff;
-			}
-			else
+			for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
 			{
-				state += release->get() * diff;
+				auto* output = buffer.getWritePointer(channel);
+				auto* source = araBuffer.getReadPointer(channel);
+
+				for (int i = 0; i < numSamples; ++i)
+					output[i] = (SampleType)source[i];
 			}
 		}
+
+		return;
 	}
+#endif
+
+	for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+		buffer.clear(i, 0, buffer.getNumSamples());
+
+	if (totalNumInputChannels == 0)
+		return;
 
-	compressor.setAttack(attack->get());
-	compressor.setRelease(release->get());
-	compressor.setThreshold(threshold->get());
-	compressor.setRatio(ratio->get());
+	viewerBuffer.setSize(2, numSamples, false, false, true);
 
-	buffer.applyGain(juce::Decibels::decibelsToGain(gain->get() + state));
+	// Only the viewers need the dry signal, and they only show the first channel
+	auto* dry = viewerBuffer.getWritePointer(0);
+	auto* wet = viewerBuffer.getWritePointer(1);
+	auto* input = buffer.getReadPointer(0);
 
-	auto block = juce::dsp::AudioBlock<float>(buffer);
-	auto replace = juce::dsp::ProcessContextReplacing<float>(block);
-	compressor.process(replace);
+	for (int i = 0; i < numSamples; ++i)
+		dry[i] = (float)input[i];
 
-	for (int channel = 0; channel < totalNumInputChannels; ++channel)
+	// Coming back from bypass, the delayed dry signal fades out against the processed one
+	const auto leavingBypass = bypassMix > 0.f;
+	bypassed = false;
+
+	if (leavingBypass)
 	{
-		for (int sample = 0; sample < numSamples; ++sample)
+		bypassScratch.setSize(totalNumInputChannels, numSamples, false, false, true);
+		delayDry(buffer.getArrayOfReadPointers(), bypassScratch.getArrayOfWritePointers(), totalNumInputChannels, numSamples);
+	}
+	else
+	{
+		delayDry<SampleType, SampleType>(buffer.getArrayOfReadPointers(), nullptr, totalNumInputChannels, numSamples);
+	}
+
+	updateCompressorSettings();
+	inputLoudnessMeter.process(buffer.getArrayOfReadPointers(), numSamples);
+	compressor.process(buffer.getArrayOfWritePointers(), totalNumInputChannels, numSamples);
+
+	if (leavingBypass)
+		blendWithScratch(buffer, totalNumInputChannels, true);
+
+	outputLoudnessMeter.process(buffer.getArrayOfReadPointers(), numSamples);
+
+	Dsp::StageProfiler::ScopedTimer meteringTimer(&profiler, Dsp::Stage::metering, numSamples);
+
+	if constexpr (std::is_same_v<SampleType, float>)
+	{
+		waveViewerCompressed.pushBuffer(buffer);
+	}
+	else
+	{
+		for (int i = 0; i < numSamples; ++i)
+			wet[i] = (float)input[i];
+
+		waveViewerCompressed.pushBuffer(&wet, 1, numSamples);
+	}
+
+	waveViewerUncompressed.pushBuffer(&dry, 1, numSamples);
+	analysis->push(buffer.getArrayOfReadPointers(), totalNumOutputChannels, numSamples, compressor.getEnvelopeDecibels(),
+		&inputLoudnessMeter.getSteps(), &outputLoudnessMeter.getSteps());
+}
+
+template <typename SampleType>
+void CompressorV2AudioProcessor::bypassSamples(juce::AudioBuffer<SampleType>& buffer)
+{
+	juce::ScopedNoDenormals noDenormals;
+	const auto numChannels = juce::jmin(getTotalNumInputChannels(), buffer.getNumChannels());
+	const auto numSamples = buffer.getNumSamples();
+
+	for (auto i = numChannels; i < buffer.getNumChannels(); ++i)
+		buffer.clear(i, 0, numSamples);
+
+	if (numChannels == 0)
+		return;
+
+	updateCompressorSettings();
+	bypassed = true;
+
+	if (bypassMix < 1.f)
+	{
+		// Still fading in the bypass: the processed signal is needed until the ramp ends
+		bypassScratch.setSize(numChannels, numSamples, false, false, true);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const auto* input = buffer.getReadPointer(channel);
+			auto* wet = bypassScratch.getWritePointer(channel);
+
+			for (int i = 0; i < numSamples; ++i)
+				wet[i] = (double)input[i];
+		}
+
+		compressor.process(bypassScratch.getArrayOfWritePointers(), numChannels, numSamples);
+		delayDry(buffer.getArrayOfReadPointers(), buffer.getArrayOfWritePointers(), numChannels, numSamples);
+		blendWithScratch(buffer, numChannels, false);
+	}
+	else
+	{
+		// Only the detector and envelope keep going, so coming back needs no settling
+		compressor.track(buffer.getArrayOfReadPointers(), numChannels, numSamples);
+		delayDry(buffer.getArrayOfReadPointers(), buffer.getArrayOfWritePointers(), numChannels, numSamples);
+	}
+}
+
+template <typename InputType, typename OutputType>
+void CompressorV2AudioProcessor::delayDry(const InputType* const* input, OutputType* const* output, int numChannels, int numSamples) noexcept
+{
+	const auto latency = dryDelay.getNumSamples();
+	numChannels = juce::jmin(numChannels, dryDelay.getNumChannels());
+
+	if (latency == 0)
+	{
+		if (output != nullptr)
+			for (int channel = 0; channel < numChannels; ++channel)
+				if ((const void*)output[channel] != (const void*)input[channel])
+					for (int i = 0; i < numSamples; ++i)
+						output[channel][i] = (OutputType)input[channel][i];
+
+		return;
+	}
+
+	auto position = dryDelayPosition;
+
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		auto* line = dryDelay.getWritePointer(channel);
+		position = dryDelayPosition;
+
+		// Read before write, so output may be the input
+		for (int i = 0; i < numSamples; ++i)
 		{
-			wetData[sample] = channelData[sample];
-			channelData[sample] = (dryData[sample] * (1.0f - dryWetMix->get())) + (wetData[sample] * dryWetMix->get());
+			const auto delayed = line[position];
+			line[position] = (double)input[channel][i];
+
+			if (output != nullptr)
+				output[channel][i] = (OutputType)delayed;
+
+			if (++position == latency)
+				position = 0;
 		}
 	}
 
-	rmsLevelInputLeft = juce::Decibels::gainToDecibels(dryBuffer.getRMSLevel(0, 0, dryBuffer.getNumSamples()));
-	rmsLevelInputRight = juce::Decibels::gainToDecibels(dryBuffer.getRMSLevel(1, 0, dryBuffer.getNumSamples()));
+	dryDelayPosition = position;
+}
 
-	rmsLevelOutputLeft = juce::Decibels::gainToDecibels(buffer.getRMSLevel(0, 0, buffer.getNumSamples()));
-	rmsLevelOutputRight = juce::Decibels::gainToDecibels(buffer.getRMSLevel(1, 0, buffer.getNumSamples()));
+template <typename SampleType>
+void CompressorV2AudioProcessor::blendWithScratch(juce::AudioBuffer<SampleType>& buffer, int numChannels, bool scratchIsDry) noexcept
+{
+	// bypassMix is the dry signal's share; it heads for 0 while processing and 1 while bypassed
+	const auto target = scratchIsDry ? 0.f : 1.f;
+	const auto step = scratchIsDry ? -bypassFadeStep : bypassFadeStep;
+	auto mix = bypassMix;
 
-	waveViewerCompressed.pushBuffer(buffer);
-	waveViewerUncompressed.pushBuffer(dryBuffer);
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		auto* output = buffer.getWritePointer(channel);
+		const auto* scratch = bypassScratch.getReadPointer(channel);
+		mix = bypassMix;
+
+		for (int i = 0; i < buffer.getNumSamples(); ++i)
+		{
+			mix = scratchIsDry ? juce::jmax(target, mix + step) : juce::jmin(target, mix + step);
+			const auto scratchShare = (SampleType)(scratchIsDry ? mix : 1.f - mix);
+			output[i] += scratchShare * ((SampleType)scratch[i] - output[i]);
+		}
+	}
+
+	bypassMix = mix;
+}
+
+void CompressorV2AudioProcessor::updateAdaptiveQuality(int numSamples, double elapsedSeconds)
+{
+	// The controller steps down from the Eco choice, so a coarser choice leaves it fewer steps.
+	// The core crossfades a change of control interval itself, so stepping back up doesn't click.
+	adaptiveQuality.setNumLevels((int)std::size(ecoControlIntervals) - eco->getIndex());
+
+	// Offline renders have no deadline, and must come out the same however long they take
+	if (adaptive->get() && !isNonRealtime())
+		adaptiveQuality.update(numSamples, elapsedSeconds);
+	else if (adaptiveQuality.getLevel() != 0)
+		adaptiveQuality.reset();
 }
 
 //==============================================================================
 bool CompressorV2AudioProcessor::hasEditor() const
 {
+#if COMPRESSORV2_HEADLESS
+	return false;
+#else
 	return true; // (change this to false if you choose to not supply an editor)
+#endif
 }
 
 juce::AudioProcessorEditor* CompressorV2AudioProcessor::createEditor()
 {
+#if COMPRESSORV2_HEADLESS
+	return nullptr;
+#else
 	return new CompressorV2AudioProcessorEditor(*this);
 	//return new juce::GenericAudioProcessorEditor(*this);
+#endif
 }
 
 //==============================================================================
 void CompressorV2AudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-	juce::MemoryOutputStream memory(destData, true);
-	apvts.state.writeToStream(memory);
+	std::array<float, numStateParameters> values;
+
+	for (int i = 0; i < numStateParameters; ++i)
+		values[(size_t)i] = stateParameters[(size_t)i]->convertFrom0to1(stateParameters[(size_t)i]->getValue());
+
+	auto slots = writePresetSlots();
+	CompactState::write(destData, values.data(), numStateParameters, { { presetSlotsTag, slots.getData(), (int)slots.getSize() } });
 }
 
 void CompressorV2AudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
+	auto trace = traceScope("setStateInformation");
+
+	std::array<float, numStateParameters> values;
+	auto numValues = CompactState::read(data, sizeInBytes, values.data(), numStateParameters);
+
+	if (numValues >= 0)
+	{
+		applyStateValues(values.data(), juce::jmin(numValues, numStateParameters));
+		readPresetSlots(CompactState::findRecord(data, sizeInBytes, presetSlotsTag));
+		return;
+	}
+
+	// States saved before the compact format are a serialised apvts.state tree
 	auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
 	if (tree.isValid())
 	{
@@ -247,6 +630,187 @@ void CompressorV2AudioProcessor::setStateInformation(const void* data, int sizeI
 	}
 }
 
+void CompressorV2AudioProcessor::applyStateValues(const float* values, int numValues)
+{
+	// Parameters missing from an older state go back to their defaults
+	for (int i = 0; i < numStateParameters; ++i)
+	{
+		auto* parameter = stateParameters[(size_t)i];
+		auto normalised = i < numValues && std::isfinite(values[i]) ? parameter->convertTo0to1(values[i]) : parameter->getDefaultValue();
+
+		if (normalised != parameter->getValue())
+			parameter->setValueNotifyingHost(normalised);
+	}
+}
+
+void CompressorV2AudioProcessor::storePresetSlot(int slot)
+{
+	if (!juce::isPositiveAndBelow(slot, numPresetSlots))
+		return;
+
+	presetSlots[(size_t)slot] = getCurrentSettings();
+	activePresetSlot = slot;
+}
+
+bool CompressorV2AudioProcessor::recallPresetSlot(int slot, bool updateParameters)
+{
+	if (!isPresetSlotStored(slot))
+		return false;
+
+	auto trace = traceScope("recallPresetSlot");
+	const auto settings = *presetSlots[(size_t)slot];
+	activePresetSlot = slot;
+
+	if (!updateParameters)
+	{
+		recalledSettings.publish(std::make_unique<const ChainSettings>(settings));
+		return true;
+	}
+
+	// Published inside the odd count, so the audio thread takes the whole snapshot and
+	// not the parameters half way through changing
+	parameterSyncCount.fetch_add(1);
+	recalledSettings.publish(std::make_unique<const ChainSettings>(settings));
+
+	for (int i = 0; i < numChainParameters; ++i)
+	{
+		auto* parameter = stateParameters[(size_t)i];
+		auto normalised = parameter->convertTo0to1(settings.*chainFields[i]);
+
+		if (normalised != parameter->getValue())
+			parameter->setValueNotifyingHost(normalised);
+	}
+
+	parameterSyncCount.fetch_add(1);
+	return true;
+}
+
+bool CompressorV2AudioProcessor::isPresetSlotStored(int slot) const
+{
+	return juce::isPositiveAndBelow(slot, numPresetSlots) && presetSlots[(size_t)slot].has_value();
+}
+
+const ChainSettings& CompressorV2AudioProcessor::updateTargetSettings() noexcept
+{
+	const auto syncCount = parameterSyncCount.load();
+	const auto fromParameters = getCurrentSettings();
+	const auto parametersSettled = (syncCount & 1u) == 0 && parameterSyncCount.load() == syncCount;
+
+	if (auto* recalled = recalledSettings.acquireNew())
+	{
+		targetSettings = *recalled;
+
+		if (parametersSettled)
+			parameterBaseline = fromParameters;
+	}
+	else if (parametersSettled)
+	{
+		// Whatever the host or the editor has moved since overrides the recalled value, one parameter at a time.
+		// Parameters a sync wrote only catch up with targets already set, perhaps since overtaken by a controller.
+		if (syncCount == settledSyncCount)
+		{
+			for (auto field : chainFields)
+			{
+				if (fromParameters.*field != parameterBaseline.*field)
+					targetSettings.*field = fromParameters.*field;
+			}
+		}
+
+		parameterBaseline = fromParameters;
+	}
+
+	if (parametersSettled)
+		settledSyncCount = syncCount;
+
+	return targetSettings;
+}
+
+void CompressorV2AudioProcessor::timerCallback()
+{
+	const auto pending = pendingControllers.exchange(0);
+
+	if (pending == 0)
+		return;
+
+	parameterSyncCount.fetch_add(1);
+
+	for (int i = 0; i < numChainParameters; ++i)
+	{
+		if ((pending & (1u << i)) == 0)
+			continue;
+
+		auto* parameter = stateParameters[(size_t)i];
+		const auto normalised = (float)controllerValues[(size_t)i].load(std::memory_order_relaxed) / 127.f;
+
+		if (normalised != parameter->getValue())
+			parameter->setValueNotifyingHost(normalised);
+	}
+
+	parameterSyncCount.fetch_add(1);
+}
+
+juce::MemoryBlock CompressorV2AudioProcessor::writePresetSlots() const
+{
+	// int16 active slot, int16 slot count, int16 values per slot, then per slot an int16 stored flag and its values
+	juce::MemoryBlock block;
+	juce::MemoryOutputStream stream(block, false);
+
+	stream.writeShort((short)activePresetSlot);
+	stream.writeShort((short)numPresetSlots);
+	stream.writeShort((short)numChainParameters);
+
+	for (const auto& slot : presetSlots)
+	{
+		stream.writeShort(slot.has_value() ? 1 : 0);
+
+		for (auto field : chainFields)
+			stream.writeFloat(slot.has_value() ? (*slot).*field : 0.f);
+	}
+
+	stream.flush();
+	return block;
+}
+
+void CompressorV2AudioProcessor::readPresetSlots(const CompactState::Record& record)
+{
+	for (auto& slot : presetSlots)
+		slot.reset();
+
+	activePresetSlot = -1;
+
+	if (record.data == nullptr || record.size < 6)
+		return;
+
+	juce::MemoryInputStream stream(record.data, (size_t)record.size, false);
+	const auto active = (int)stream.readShort();
+	const auto numSlots = (int)stream.readShort();
+	const auto valuesPerSlot = (int)stream.readShort();
+
+	if (numSlots < 0 || valuesPerSlot < 0 || record.size < 6 + (juce::int64)numSlots * (2 + valuesPerSlot * (juce::int64)sizeof(float)))
+		return;
+
+	for (int i = 0; i < numSlots; ++i)
+	{
+		const auto stored = stream.readShort() != 0;
+		ChainSettings settings;
+
+		// Fields a newer version added are skipped, ones an older version lacked keep the ChainSettings defaults
+		for (int value = 0; value < valuesPerSlot; ++value)
+		{
+			const auto plain = stream.readFloat();
+
+			if (value < numChainParameters && std::isfinite(plain))
+				settings.*chainFields[value] = stateParameters[(size_t)value]->getNormalisableRange().snapToLegalValue(plain);
+		}
+
+		if (stored && i < numPresetSlots)
+			presetSlots[(size_t)i] = settings;
+	}
+
+	if (isPresetSlotStored(active))
+		activePresetSlot = active;
+}
+
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
 {
 	ChainSettings settings;
@@ -257,7 +821,7 @@ ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
 	settings.attack = apvts.getRawParameterValue("Attack")->load();
 	settings.release = apvts.getRawParameterValue("Release")->load();
 	settings.mix = apvts.getRawParameterValue("Mix")->load();
-	settings.gain = apvts.getRawParameterValue("Gain ")->load();
+	settings.gain = apvts.getRawParameterValue("Gain")->load();
 
 	return settings;
 }
@@ -272,55 +836,133 @@ juce::AudioProcessorValueTreeState::ParameterLayout CompressorV2AudioProcessor::
 	layout.add(std::make_unique<juce::AudioParameterFloat>("Release", "Release", juce::NormalisableRange<float>(20.f, 500.f, 1.0f, 1.0f), 20.f));
 	layout.add(std::make_unique<juce::AudioParameterFloat>("Mix", "Mix", juce::NormalisableRange<float>(0.f, 1.f, 0.1f, 1.0f), 0.5f));
 	layout.add(std::make_unique<juce::AudioParameterFloat>("Gain", "Gain", juce::NormalisableRange<float>(0.f, 36.0f, 1.0f, 1.0f), 0.f));
+	layout.add(std::make_unique<juce::AudioParameterFloat>("Morph", "Morph", juce::NormalisableRange<float>(0.f, 2000.f, 1.0f, 0.5f), 50.f));
+	layout.add(std::make_unique<juce::AudioParameterChoice>("Eco", "Eco", juce::StringArray{ "Off", "4", "8", "16", "32" }, 0));
+	layout.add(std::make_unique<juce::AudioParameterBool>("Adaptive", "Adaptive quality", false));
+	layout.add(std::make_unique<juce::AudioParameterChoice>("AutoMakeup", "Auto makeup", juce::StringArray{ "Off", "Curve", "Running" }, 0));
 
 	return layout;
 }
 
-void CompressorV2AudioProcessor::setKnee()
+ChainSettings CompressorV2AudioProcessor::getCurrentSettings() const
 {
-	slope = (1 / ratio->get()) - 1.f;
-	kneeHalf = knee->get() / 2.0f;
+	ChainSettings settings;
 
-	overShoot = inputLevel - threshold->get();
+	settings.threshold = threshold->get();
+	settings.knee = knee->get();
+	settings.ratio = ratio->get();
+	settings.attack = attack->get();
+	settings.release = release->get();
+	settings.mix = dryWetMix->get();
+	settings.gain = gain->get();
 
-	if (overShoot <= -kneeHalf)
-	{
-		overShoot = 0.0f;
+	return settings;
+}
 
-	}
-	else if (overShoot > -kneeHalf && overShoot <= kneeHalf)
-	{
-		overShoot = 0.5f * slope * juce::square(overShoot + kneeHalf) / knee->get();
+int CompressorV2AudioProcessor::getControlInterval() const
+{
+	return ecoControlIntervals[getQualityLevel()];
+}
 
-	}
-	else
-	{
-		overShoot = slope * overShoot;
-	}
+int CompressorV2AudioProcessor::getQualityLevel() const
+{
+	return juce::jlimit(0, (int)std::size(ecoControlIntervals) - 1, eco->getIndex() + adaptiveQuality.getLevel());
 }
 
-float CompressorV2AudioProcessor::getRMSValueOutput(const int channel)
+juce::String CompressorV2AudioProcessor::getQualityName(int level)
 {
-	if (channel == 0)
-	{
-		return rmsLevelOutputLeft;
-	}
-	else if (channel == 1)
-	{
-		return rmsLevelOutputRight;
-	}
+	return level == 0 ? juce::String("Full") : "Eco " + juce::String(ecoControlIntervals[juce::jlimit(0, (int)std::size(ecoControlIntervals) - 1, level)]);
+}
+
+int CompressorV2AudioProcessor::getWarmUpSamples(float toleranceDb) const
+{
+	return compressor.getWarmUpSamples(toleranceDb);
 }
 
-float CompressorV2AudioProcessor::getRMSValueInput(const int channel)
+Dsp::MeterReading CompressorV2AudioProcessor::takeMeterReading(int channel)
 {
-	if (channel == 0)
+	return compressor.getMeters()[channel].take();
+}
+
+int CompressorV2AudioProcessor::getNumMeterChannels() const
+{
+	return compressor.getMeters().getNumChannels();
+}
+
+size_t CompressorV2AudioProcessor::getInstanceMemoryBytes() const
+{
+	const auto bufferBytes = [](const auto& buffer)
 	{
-		return rmsLevelInputLeft;
-	}
-	else if (channel == 1)
+		return (size_t)buffer.getNumChannels() * (size_t)buffer.getNumSamples() * sizeof(*buffer.getReadPointer(0));
+	};
+
+	// Two single channel visualisers, each keeping one Range<float> per buffered sample
+	auto bytes = sizeof(*this) + 2 * 256 * sizeof(juce::Range<float>);
+
+	bytes += compressor.getHeapSizeInBytes() + analysis->getSizeInBytes();
+	bytes += bufferBytes(bypassScratch) + bufferBytes(dryDelay) + bufferBytes(viewerBuffer);
+#if JucePlugin_Enable_ARA
+	bytes += bufferBytes(araBuffer);
+#endif
+
+	return bytes;
+}
+
+juce::String CompressorV2AudioProcessor::getMemoryReport() const
+{
+	return sharedResources->getMemoryReport(getInstanceMemoryBytes(), numLiveInstances.load());
+}
+
+void CompressorV2AudioProcessor::setProfilingEnabled(bool shouldBeEnabled)
+{
+	if (shouldBeEnabled && !profiler.isEnabled())
 	{
-		return rmsLevelInputRight;
+		profiler.reset();
+		compressor.resetPathCounts();
+		gainReductionHistogram->clear();
 	}
+
+	profiler.setEnabled(shouldBeEnabled);
+}
+
+bool CompressorV2AudioProcessor::isProfilingEnabled() const
+{
+	return profiler.isEnabled();
+}
+
+Dsp::StageStats CompressorV2AudioProcessor::getStageStats(Dsp::Stage stage) const
+{
+	return profiler.getStats(stage);
+}
+
+Dsp::PathCounts CompressorV2AudioProcessor::getPathCounts() const
+{
+	return compressor.getPathCounts();
+}
+
+Dsp::FaultCounts CompressorV2AudioProcessor::getFaultCounts() const
+{
+	return compressor.getFaultCounts();
+}
+
+bool CompressorV2AudioProcessor::startTracing(const juce::File& outputFile)
+{
+	return tracer->start(outputFile);
+}
+
+void CompressorV2AudioProcessor::stopTracing()
+{
+	tracer->stop();
+}
+
+bool CompressorV2AudioProcessor::isTracing() const
+{
+	return tracer->isRecording();
+}
+
+TraceRecorder::ScopedEvent CompressorV2AudioProcessor::traceScope(const char* name)
+{
+	return TraceRecorder::ScopedEvent(*tracer, name, instanceId);
 }
 
 //========================s======================================================
@@ -9,14 +9,14 @@
 #pragma once
 
 #include <JuceHeader.h>
-
-
-struct ChainSettings
-{
-    float threshold{}, knee{}, ratio{}, attack{}, release{}, gain{}, mix{};
-};
-
-
+#include "SharedResources.h"
+#include "Dsp/StageProfiler.h"
+#include "TraceRecorder.h"
+#include "AnalysisWorker.h"
+#include "Dsp/Compressor.h"
+#include "Dsp/SnapshotExchange.h"
+#include "Dsp/AdaptiveQuality.h"
+#include "CompactState.h"
 
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
@@ -24,7 +24,8 @@ ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 //==============================================================================
 /**
 */
-class CompressorV2AudioProcessor  : public juce::AudioProcessor
+class CompressorV2AudioProcessor  : public juce::AudioProcessor,
+                                    private juce::Timer
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -37,12 +38,17 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void reset() override;
 
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -71,26 +77,168 @@ public:
     juce::AudioProcessorValueTreeState apvts{ *this, nullptr, "Parameters", createParameterLayout() };
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 
-    void setKnee();
-    float getRMSValueOutput(const int level);
-    float getRMSValueInput(const int level);
+    ChainSettings getCurrentSettings() const;
+
+    // Samples per gain computation for each choice of the Eco parameter
+    static constexpr int ecoControlIntervals[]{ 1, 4, 8, 16, 32 };
+    int getControlInterval() const;
+
+    // Eco choice in use: the parameter's, plus however many steps the adaptive controller has taken
+    // down from it. An output rather than a parameter, so nothing on the audio thread notifies the host.
+    int getQualityLevel() const;
+    static juce::String getQualityName(int level);
+    std::uint64_t getQualityDowngrades() const { return adaptiveQuality.getDowngrades(); }
+
+    // A/B/C/D preset slots, message thread only. A recall reaches the audio thread as one
+    // snapshot and morphs to it over the Morph time; updateParameters then also moves the
+    // parameters to match, which the audio thread ignores until they have all landed.
+    static constexpr int numPresetSlots{ 4 };
+    void storePresetSlot(int slot);
+    bool recallPresetSlot(int slot, bool updateParameters = true);
+    bool isPresetSlotStored(int slot) const;
+    int getActivePresetSlot() const { return activePresetSlot; }
+
+    // Pre-roll needed for a reset instance to converge on a running one, see Dsp::Compressor
+    int getWarmUpSamples(float toleranceDb) const;
+
+    // Raw levels accumulated since the previous call; dB and ballistics are up to the caller
+    Dsp::MeterReading takeMeterReading(int channel);
+    int getNumMeterChannels() const;
 
     juce::AudioVisualiserComponent waveViewerCompressed; 
     juce::AudioVisualiserComponent waveViewerUncompressed;
 
+    size_t getInstanceMemoryBytes() const;
+    juce::String getMemoryReport() const;
+
+    void setProfilingEnabled(bool shouldBeEnabled);
+    bool isProfilingEnabled() const;
+    Dsp::StageStats getStageStats(Dsp::Stage stage) const;
+    Dsp::PathCounts getPathCounts() const;
+    Dsp::FaultCounts getFaultCounts() const;
+
+    // Off the audio thread, from AnalysisWorker
+    const GainReductionHistogram& getGainReductionHistogram() const { return *gainReductionHistogram; }
+    juce::uint64 getDroppedAnalysisBlocks() const { return analysis->getDroppedBlocks(); }
+    juce::uint64 getDroppedLoudnessSteps() const { return analysis->getDroppedLoudnessSteps(); }
+    LoudnessAnalysis::Reading getInputLoudness() const { return loudness->getInput(); }
+    LoudnessAnalysis::Reading getOutputLoudness() const { return loudness->getOutput(); }
+    void resetLoudness() { loudness->requestReset(); }
+
+    bool startTracing(const juce::File& outputFile);
+    void stopTracing();
+    bool isTracing() const;
+    TraceRecorder::ScopedEvent traceScope(const char* name);
+
 private:
-    float inputLevel{};
-    float slope{};
-    float kneeHalf{};
-    float overShoot{};
-    float state{};
+    juce::SharedResourcePointer<SharedResources> sharedResources;
+    std::shared_ptr<const Dsp::FastMathTables> fastMath{ sharedResources->getFastMathTables() };
+    juce::SharedResourcePointer<TraceRecorder> tracer;
+    const int instanceId;
+
+    juce::SharedResourcePointer<AnalysisWorker> analysisWorker;
+    std::shared_ptr<AnalysisWorker::Client> analysis{ std::make_shared<AnalysisWorker::Client>() };
+    GainReductionHistogram* gainReductionHistogram{};
+    LoudnessAnalysis* loudness{};
+    // K-weighting and 100 ms mean squares on the audio thread, gating on the analysis worker
+    Dsp::KWeightedMeter inputLoudnessMeter, outputLoudnessMeter;
+
+    // Puts the core's processing stages on the trace timeline
+    struct TraceObserver : Dsp::StageProfiler::Observer
+    {
+        TraceObserver(TraceRecorder& r, int id) : recorder(r), processId(id) {}
+
+        bool isObserving() const noexcept override { return recorder.isRecording(); }
 
-    float rmsLevelOutputLeft, rmsLevelOutputRight;
-    float rmsLevelInputLeft,rmsLevelInputRight;
+        void stageBoundary(Dsp::Stage stage, bool began) noexcept override
+        {
+            recorder.record(Dsp::getStageName(stage), began ? 'B' : 'E', processId);
+        }
 
-    float* channelData{};
-    float* dryData{};
-    float* wetData{};
+        TraceRecorder& recorder;
+        int processId;
+    };
+
+    TraceObserver traceObserver{ *tracer, instanceId };
+
+    template <typename SampleType>
+    void processHostBlock(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midiMessages);
+    template <typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer);
+    template <typename SampleType>
+    void bypassSamples(juce::AudioBuffer<SampleType>& buffer);
+
+    // MIDI CC firstMidiController + i, on any channel, sets the i-th chain parameter (state order)
+    // at the sample it arrives on; hosts don't hand JUCE their sample-accurate parameter queues.
+    // The AU stays an 'aufx' effect, which AU hosts send no MIDI, so it has no mapping.
+    static constexpr int firstMidiController{ 20 };
+    // The chain parameter the message is mapped to, or -1
+    int getMidiMappedIndex(const juce::MidiMessage& message) const noexcept;
+
+    // Renders the block in sub-blocks split at the mapped controller changes, applying each one
+    // to the target settings between the sub-blocks either side of it
+    template <typename SampleType, typename Render>
+    void splitAtControllers(juce::AudioBuffer<SampleType>& buffer, const juce::MidiBuffer& midiMessages, Render&& render);
+
+    // Pushes the parameters, morph time, eco interval and auto makeup to the core
+    void updateCompressorSettings();
+
+    // Host bypass: the input delayed by the reported latency, crossfaded with the processed
+    // signal over bypassFadeSeconds. bypassMix is the dry share, 0 while processing; bypassed
+    // says which way the last block went, so reset() can finish a fade.
+    static constexpr double bypassFadeSeconds{ 0.01 };
+    float bypassMix{}, bypassFadeStep{ 1.f };
+    bool bypassed{};
+    juce::AudioBuffer<double> bypassScratch, dryDelay;
+    int dryDelayPosition{};
+
+    // Feeds the latency delay; output, if not null, gets the delayed signal and may be the input
+    template <typename InputType, typename OutputType>
+    void delayDry(const InputType* const* input, OutputType* const* output, int numChannels, int numSamples) noexcept;
+    // Ramps bypassMix towards processing (scratch holds the dry signal) or bypass (scratch holds the wet)
+    template <typename SampleType>
+    void blendWithScratch(juce::AudioBuffer<SampleType>& buffer, int numChannels, bool scratchIsDry) noexcept;
+
+    // Parameter order of the compact state's value block: only ever append to it.
+    // The first numChainParameters are the ChainSettings fields, in that order.
+    static constexpr int numStateParameters{ 11 };
+    static constexpr int numChainParameters{ 7 };
+    static const char* const stateParameterIds[numStateParameters];
+    std::array<juce::RangedAudioParameter*, numStateParameters> stateParameters{};
+
+    // Sets the parameters from plain values in state order, touching only the ones that change
+    void applyStateValues(const float* values, int numValues);
+
+    // Audio thread: what the compressor should be heading for, from the latest recall and any
+    // parameter moved since
+    const ChainSettings& updateTargetSettings() noexcept;
+
+    static constexpr juce::uint32 presetSlotsTag{ CompactState::makeTag("SLOT") };
+    juce::MemoryBlock writePresetSlots() const;
+    void readPresetSlots(const CompactState::Record& record);
+
+    std::array<std::optional<ChainSettings>, numPresetSlots> presetSlots;
+    int activePresetSlot{ -1 };
+
+    Dsp::SnapshotExchange<ChainSettings> recalledSettings;
+    // Odd while recallPresetSlot() or timerCallback() is writing the parameters; the audio
+    // thread keeps the count it last read them settled at
+    std::atomic<unsigned int> parameterSyncCount{};
+    unsigned int settledSyncCount{};
+    ChainSettings targetSettings, parameterBaseline;
+
+    // Controller values already in the target settings that the parameters don't show yet, 0 to
+    // 127 per chain parameter with a bit each in pendingControllers; the timer writes them
+    std::array<std::atomic<int>, numChainParameters> controllerValues{};
+    std::atomic<juce::uint32> pendingControllers{};
+    void timerCallback() override;
+
+    // First channel of the block for the wave viewers, which are mono and float only: dry, then wet
+    juce::AudioBuffer<float> viewerBuffer;
+
+   #if JucePlugin_Enable_ARA
+    juce::AudioBuffer<float> araBuffer;
+   #endif
 
     juce::AudioParameterFloat* knee{nullptr};
     juce::AudioParameterFloat* threshold{nullptr};
@@ -99,8 +247,18 @@ private:
     juce::AudioParameterFloat* release{nullptr};
     juce::AudioParameterFloat* gain{nullptr};
     juce::AudioParameterFloat* dryWetMix{nullptr};
+    juce::AudioParameterFloat* morphTime{nullptr};
+    juce::AudioParameterChoice* eco{nullptr};
+    juce::AudioParameterBool* adaptive{nullptr};
+    // Off, Curve or Running, in Dsp::AutoMakeup order
+    juce::AudioParameterChoice* autoMakeup{nullptr};
+
+    // Steps the Eco choice down under CPU pressure, only while playing in real time
+    Dsp::AdaptiveQuality adaptiveQuality{ (int)std::size(ecoControlIntervals) };
+    void updateAdaptiveQuality(int numSamples, double elapsedSeconds);
 
-    juce::dsp::Compressor<float> compressor;
+    Dsp::Compressor compressor{ fastMath };
+    Dsp::StageProfiler profiler;
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CompressorV2AudioProcessor)
 };
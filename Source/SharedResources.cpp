@@ -0,0 +1,74 @@
+/*
+  ==============================================================================
+
+	Process-wide registry for immutable data that plugin instances can share.
+
+  ==============================================================================
+*/
+
+#include "SharedResources.h"
+
+std::shared_ptr<const Dsp::FastMathTables> SharedResources::getFastMathTables()
+{
+	return getOrBuild<Dsp::FastMathTables>("fastMathTables", [](size_t& sizeInBytes)
+	{
+		auto tables = std::make_unique<Dsp::FastMathTables>();
+		sizeInBytes = tables->getSizeInBytes();
+		return tables;
+	});
+}
+
+juce::Font SharedResources::getFont(float height)
+{
+	return *getOrBuild<juce::Font>("font_" + juce::String(height), [height](size_t& sizeInBytes)
+	{
+		sizeInBytes = sizeof(juce::Font);
+		return std::make_unique<juce::Font>(height);
+	});
+}
+
+juce::Image SharedResources::getKnobImage(int diameter, float scale)
+{
+	// The outline stroke is centred on the knob edge, so leave a pixel of room around it
+	const auto size = juce::roundToInt((float)(diameter + 2) * scale);
+
+	// Keyed on what it is drawn from: different diameters and scales can round to the same size
+	const auto key = "knob_" + juce::String(diameter) + "_" + juce::String(scale, 3);
+
+	return *getOrBuild<juce::Image>(key, [diameter, scale, size](size_t& sizeInBytes)
+	{
+		auto image = std::make_unique<juce::Image>(juce::Image::ARGB, size, size, true);
+		juce::Graphics g(*image);
+		g.addTransform(juce::AffineTransform::scale(scale));
+
+		auto bounds = juce::Rectangle<float>(1.f, 1.f, (float)diameter, (float)diameter);
+		g.setColour(juce::Colours::deeppink.withBrightness(0.5f));
+		g.fillEllipse(bounds);
+
+		g.setColour(juce::Colours::ghostwhite);
+		g.drawEllipse(bounds, 2.f);
+
+		sizeInBytes = (size_t)size * (size_t)size * 4;
+		return image;
+	});
+}
+
+juce::String SharedResources::getMemoryReport(size_t instanceBytes, int numInstances) const
+{
+	const juce::ScopedLock lock(entriesLock);
+
+	juce::String report;
+	size_t sharedBytes{};
+
+	for (auto& entry : entries)
+	{
+		report << "  " << entry.first << ": " << (juce::int64)entry.second.sizeInBytes << " bytes\n";
+		sharedBytes += entry.second.sizeInBytes;
+	}
+
+	return "Instances: " + juce::String(numInstances) + "\n"
+		+ "Per instance: " + juce::String((juce::int64)instanceBytes) + " bytes\n"
+		+ "Shared: " + juce::String((juce::int64)sharedBytes) + " bytes in " + juce::String((int)entries.size()) + " resources\n"
+		+ report
+		+ "Total: " + juce::String((juce::int64)(instanceBytes * (size_t)numInstances + sharedBytes)) + " bytes\n";
+}
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+	Process-wide registry for immutable data that plugin instances can share.
+
+	Hold it through juce::SharedResourcePointer<SharedResources>: the registry is
+	created by the first instance and destroyed with the last one. Resources are
+	built at most once, under a lock, and handed out as shared_ptr<const T> so a
+	consumer keeps its data alive even if the registry goes away first.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Dsp/FastMath.h"
+
+class SharedResources
+{
+public:
+	SharedResources() = default;
+
+	// The builder is only called on the first request for a key. It returns a
+	// std::unique_ptr<T> and reports the heap size of the resource in bytes.
+	template <typename ResourceType, typename Builder>
+	std::shared_ptr<const ResourceType> getOrBuild(const juce::String& key, Builder&& build)
+	{
+		const juce::ScopedLock lock(entriesLock);
+
+		auto& entry = entries[key];
+
+		if (entry.resource == nullptr)
+		{
+			size_t sizeInBytes{};
+			entry.resource = std::shared_ptr<const ResourceType>(build(sizeInBytes));
+			entry.sizeInBytes = sizeInBytes;
+		}
+
+		return std::static_pointer_cast<const ResourceType>(entry.resource);
+	}
+
+	std::shared_ptr<const Dsp::FastMathTables> getFastMathTables();
+	juce::Font getFont(float height);
+	juce::Image getKnobImage(int diameter, float scale);
+
+	juce::String getMemoryReport(size_t instanceBytes, int numInstances) const;
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<const void> resource;
+		size_t sizeInBytes{};
+	};
+
+	juce::CriticalSection entriesLock;
+	std::map<juce::String, Entry> entries;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedResources)
+};
@@ -0,0 +1,635 @@
+/*
+  ==============================================================================
+
+	CompressorV2Tests: unit tests for the JUCE-free core, run by ctest.
+
+	Checks Dsp::Compressor against values worked out by hand rather than
+	against another implementation: the transfer curve at chosen points,
+	the settled gain of a constant level, and the envelope one attack or
+	release time after a step, which a one-pole puts at 1 - 1/e and 1/e
+	of the way. The tolerances leave room for the table based dB
+	conversions, which are good to about 1e-3 dB.
+
+  ==============================================================================
+*/
+
+#include "../Dsp/AdaptiveQuality.h"
+#include "../Dsp/Compressor.h"
+#include "../Dsp/Loudness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr double sampleRate{ 48000.0 };
+	constexpr int blockSize{ 512 };
+
+	int numFailed{};
+
+	void check(bool passed, const std::string& name, double actual, double expected)
+	{
+		if (passed)
+			return;
+
+		++numFailed;
+		std::cout << "FAIL " << name << ": got " << actual << ", expected " << expected << "\n";
+	}
+
+	void checkNear(const std::string& name, double actual, double expected, double tolerance)
+	{
+		check(std::abs(actual - expected) <= tolerance, name, actual, expected);
+	}
+
+	double toDecibels(double gain) { return 20.0 * std::log10(gain); }
+
+	// Runs numSamples of a constant level per channel through the compressor, returning the last output of each
+	std::vector<float> processConstant(Dsp::Compressor& compressor, const std::vector<float>& levels, int numSamples)
+	{
+		const auto numChannels = (int)levels.size();
+		std::vector<std::vector<float>> buffers((size_t)numChannels, std::vector<float>((size_t)blockSize));
+		std::vector<float*> pointers;
+
+		for (auto& buffer : buffers)
+			pointers.push_back(buffer.data());
+
+		for (int done = 0; done < numSamples;)
+		{
+			const auto length = std::min(blockSize, numSamples - done);
+
+			for (int channel = 0; channel < numChannels; ++channel)
+				std::fill(buffers[(size_t)channel].begin(), buffers[(size_t)channel].end(), levels[(size_t)channel]);
+
+			compressor.process(pointers.data(), numChannels, length);
+			done += length;
+
+			if (done == numSamples)
+			{
+				std::vector<float> last;
+
+				for (auto& buffer : buffers)
+					last.push_back(buffer[(size_t)length - 1]);
+
+				return last;
+			}
+		}
+
+		return std::vector<float>(levels.size());
+	}
+
+	void testTransferCurve()
+	{
+		Dsp::GainComputer hard;
+		hard.setParameters(-20.f, 0.f, 4.f);
+
+		checkNear("hard knee below threshold", hard.getGainDecibels(-30.f), 0.0, 1.0e-6);
+		checkNear("hard knee at threshold", hard.getGainDecibels(-20.f), 0.0, 1.0e-6);
+		checkNear("hard knee 10 dB over at 4:1", hard.getGainDecibels(-10.f), -7.5, 1.0e-5);
+		checkNear("hard knee 20 dB over at 4:1", hard.getGainDecibels(0.f), -15.0, 1.0e-5);
+
+		// 6 dB knee around -20 dB: quadratic from -23 to -17, meeting the straight line at -17
+		Dsp::GainComputer soft;
+		soft.setParameters(-20.f, 6.f, 4.f);
+
+		checkNear("soft knee at its bottom", soft.getGainDecibels(-23.f), 0.0, 1.0e-6);
+		checkNear("soft knee at threshold", soft.getGainDecibels(-20.f), -0.5625, 1.0e-5);
+		checkNear("soft knee at its top", soft.getGainDecibels(-17.f), -2.25, 1.0e-5);
+		checkNear("soft knee above it", soft.getGainDecibels(-10.f), -7.5, 1.0e-5);
+
+		Dsp::GainComputer unity;
+		unity.setParameters(-40.f, 0.f, 1.f);
+		checkNear("1:1 never reduces", unity.getGainDecibels(0.f), 0.0, 1.0e-6);
+
+		Dsp::GainComputer limiter;
+		limiter.setParameters(-10.f, 0.f, 100.f);
+		checkNear("100:1 at 10 dB over", limiter.getGainDecibels(0.f), -9.9, 1.0e-5);
+	}
+
+	void testSettledGain()
+	{
+		// 0.5 is -6.0206 dB, 13.9794 dB over a -20 dB threshold; at 4:1 that is -10.4846 dB
+		const auto expectedDb = -0.75 * (toDecibels(0.5) + 20.0);
+
+		for (auto mix : { 1.f, 0.5f })
+		{
+			Dsp::Compressor compressor;
+			compressor.setParameters({ -20.f, 0.f, 4.f, 20.f, 100.f, 6.f, mix });
+			compressor.prepare(sampleRate, blockSize, 1);
+
+			const auto output = processConstant(compressor, { 0.5f }, (int)sampleRate);
+			const auto wet = std::pow(10.0, (expectedDb + 6.0) / 20.0);
+			const auto name = "settled gain with makeup at mix " + std::to_string(mix);
+
+			checkNear(name, toDecibels(output[0] / 0.5), toDecibels(1.0 - mix + mix * wet), 2.0e-3);
+			checkNear("settled envelope", compressor.getEnvelopeDecibels(), expectedDb, 2.0e-3);
+		}
+	}
+
+	void testLinkedDetector()
+	{
+		Dsp::Compressor compressor;
+		compressor.setParameters({ -20.f, 0.f, 4.f, 20.f, 100.f, 0.f, 1.f });
+		compressor.prepare(sampleRate, blockSize, 2);
+
+		// The quiet channel is under the threshold on its own but follows the loud one
+		const auto output = processConstant(compressor, { 0.5f, 0.05f }, (int)sampleRate);
+		checkNear("linked channels share one gain", toDecibels(output[1] / 0.05), toDecibels(output[0] / 0.5), 1.0e-4);
+	}
+
+	void testAttack()
+	{
+		const auto target = -0.75 * (toDecibels(0.5) + 20.0);
+
+		for (auto attackMs : { 5.f, 20.f, 80.f })
+		{
+			Dsp::Compressor compressor;
+			compressor.setParameters({ -20.f, 0.f, 4.f, attackMs, 500.f, 0.f, 1.f });
+			compressor.prepare(sampleRate, blockSize, 1);
+
+			processConstant(compressor, { 0.5f }, (int)std::lround(attackMs * 0.001 * sampleRate));
+			checkNear("envelope one attack time (" + std::to_string((int)attackMs) + " ms) after a step",
+				compressor.getEnvelopeDecibels(), target * (1.0 - std::exp(-1.0)), 2.0e-3);
+		}
+	}
+
+	void testRelease()
+	{
+		const auto start = -0.75 * (toDecibels(0.5) + 20.0);
+
+		// Silence and a level under the knee take different paths through the core; both release the same way
+		for (auto level : { 0.f, 0.01f })
+		{
+			for (auto releaseMs : { 20.f, 100.f, 500.f })
+			{
+				Dsp::Compressor compressor;
+				compressor.setParameters({ -20.f, 0.f, 4.f, 5.f, releaseMs, 0.f, 1.f });
+				compressor.prepare(sampleRate, blockSize, 1);
+
+				processConstant(compressor, { 0.5f }, (int)sampleRate);
+				processConstant(compressor, { level }, (int)std::lround(releaseMs * 0.001 * sampleRate));
+
+				checkNear("envelope one release time (" + std::to_string((int)releaseMs) + " ms) after a drop to " + std::to_string(level),
+					compressor.getEnvelopeDecibels(), start * std::exp(-1.0), 2.0e-3);
+			}
+		}
+	}
+
+	void testCountReset()
+	{
+		Dsp::Compressor compressor;
+		compressor.setParameters({ -20.f, 0.f, 4.f, 20.f, 100.f, 0.f, 1.f });
+		compressor.prepare(sampleRate, blockSize, 1);
+
+		processConstant(compressor, { 0.5f }, blockSize * 4);
+		compressor.resetPathCounts();
+		check(compressor.getPathCounts().full == 0, "path counts after a reset", (double)compressor.getPathCounts().full, 0.0);
+
+		processConstant(compressor, { 0.5f }, blockSize * 3);
+		check(compressor.getPathCounts().full == 3, "path counts since the reset", (double)compressor.getPathCounts().full, 3.0);
+	}
+
+	// A 1500 Hz sine at 48 kHz repeats every 32 samples, so one sample per interval always sees the same phase
+	void testEcoCatchesPeaks()
+	{
+		const ChainSettings settings{ -30.f, 0.f, 8.f, 10.f, 100.f, 0.f, 1.f };
+		float fullRateDb{};
+
+		for (auto controlInterval : { 1, 4, 8, 16, 32 })
+		{
+			Dsp::Compressor compressor;
+			compressor.setParameters(settings);
+			compressor.setControlInterval(controlInterval);
+			compressor.prepare(sampleRate, blockSize, 1);
+
+			std::vector<float> sine((size_t)sampleRate);
+
+			for (size_t i = 0; i < sine.size(); ++i)
+				sine[i] = 0.5f * (float)std::sin(2.0 * 3.14159265358979 * 1500.0 * (double)i / sampleRate);
+
+			for (size_t offset = 0; offset < sine.size(); offset += blockSize)
+			{
+				auto* data = sine.data() + offset;
+				compressor.process(&data, 1, std::min(blockSize, (int)(sine.size() - offset)));
+			}
+
+			if (controlInterval == 1)
+				fullRateDb = compressor.getEnvelopeDecibels();
+			else
+				check(compressor.getEnvelopeDecibels() <= fullRateDb + 0.01f, "eco " + std::to_string(controlInterval) + " reduces a steady tone at least as much as the full rate",
+					compressor.getEnvelopeDecibels(), fullRateDb);
+		}
+	}
+
+	// The same audio and the same parameter change at the same sample, fed in different blocks
+	void testBlockSplits()
+	{
+		constexpr int length{ 48000 };
+		constexpr int changeAt{ 5001 };
+		std::vector<float> input((size_t)length * 2);
+		unsigned int seed{ 1 };
+
+		for (int i = 0; i < length; ++i)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			const auto level = (i / 6000) % 3 == 0 ? 0.9f : (i / 6000) % 3 == 1 ? 0.f : 0.05f;
+			input[(size_t)i] = level * (float)std::sin(0.03 * i);
+			input[(size_t)(length + i)] = level * ((float)seed / 4294967296.f * 2.f - 1.f);
+		}
+
+		for (auto autoMakeup : { Dsp::AutoMakeup::off, Dsp::AutoMakeup::curve, Dsp::AutoMakeup::running })
+		{
+			for (auto controlInterval : { 1, 4, 32 })
+			{
+				auto render = [&](const std::vector<int>& blockSizes)
+				{
+					Dsp::Compressor compressor;
+					compressor.setParameters({ -24.f, 6.f, 4.f, 5.f, 80.f, 0.f, 1.f });
+					compressor.setMorphTime(50.f);
+					compressor.setAutoMakeup(autoMakeup);
+					compressor.setControlInterval(controlInterval);
+					compressor.prepare(sampleRate, 700, 2);
+
+					auto output = input;
+
+					for (int offset = 0, next = 0; offset < length; next = (next + 1) % (int)blockSizes.size())
+					{
+						auto numSamples = std::min(blockSizes[(size_t)next], length - offset);
+
+						if (offset < changeAt && offset + numSamples > changeAt)
+							numSamples = changeAt - offset;
+
+						if (offset == changeAt)
+							compressor.setParameters({ -36.f, 0.f, 10.f, 1.f, 200.f, 3.f, 0.7f });
+
+						float* channels[] { output.data() + offset, output.data() + length + offset };
+						compressor.process(channels, 2, numSamples);
+						offset += numSamples;
+					}
+
+					return output;
+				};
+
+				const auto regular = render({ 512 });
+				const auto irregular = render({ 100, 1, 37, 700, 3, 1500, 250 });
+				auto maxDifference = 0.0;
+
+				for (size_t i = 0; i < regular.size(); ++i)
+					maxDifference = std::max(maxDifference, (double)std::abs(regular[i] - irregular[i]));
+
+				checkNear("makeup mode " + std::to_string((int)autoMakeup) + ", eco " + std::to_string(controlInterval) + " doesn't depend on the blocks",
+					maxDifference, 0.0, 1.0e-5);
+			}
+		}
+	}
+
+	// A bypassed instance tracking the input comes back where a processing one would be: loud, quiet and
+	// silent passages and a morph half way through, for each makeup mode at full rate and in eco
+	void testTrackMatchesProcess()
+	{
+		const auto numSamples = 96000;
+		std::vector<float> left((size_t)numSamples), right((size_t)numSamples);
+
+		for (int i = 0; i < numSamples; ++i)
+		{
+			const auto passage = (i / 6000) % 4;
+			const auto level = passage == 0 ? 0.8 : passage == 1 ? 0.002 : passage == 2 ? 0.0 : 0.3;
+			left[(size_t)i] = (float)(level * std::sin(2.0 * 3.141592653589793 * 440.0 * i / sampleRate));
+			right[(size_t)i] = (float)(level * 0.5 * std::sin(2.0 * 3.141592653589793 * 97.0 * i / sampleRate));
+		}
+
+		for (const auto autoMakeup : { Dsp::AutoMakeup::off, Dsp::AutoMakeup::curve, Dsp::AutoMakeup::running })
+		{
+			for (const auto controlInterval : { 1, 8, 32 })
+			{
+				Dsp::Compressor processing, tracking;
+
+				for (auto* each : { &processing, &tracking })
+				{
+					each->setParameters({ -30.f, 6.f, 6.f, 10.f, 120.f, 0.f, 1.f });
+					each->setMorphTime(20.f);
+					each->setAutoMakeup(autoMakeup);
+					each->setControlInterval(controlInterval);
+					each->prepare(sampleRate, blockSize, 2);
+				}
+
+				auto output = std::vector<std::vector<float>>{ left, right };
+				auto worstEnvelope = 0.0, worstMakeup = 0.0;
+				auto length = 100;
+
+				for (int done = 0; done < numSamples; done += length)
+				{
+					length = std::min({ length % blockSize + 97, numSamples - done });
+
+					if (done >= numSamples / 2 && done - length < numSamples / 2)
+					{
+						for (auto* each : { &processing, &tracking })
+							each->setParameters({ -40.f, 0.f, 10.f, 30.f, 60.f, 3.f, 1.f });
+					}
+
+					float* outputs[]{ output[0].data() + done, output[1].data() + done };
+					const float* inputs[]{ left.data() + done, right.data() + done };
+					processing.process(outputs, 2, length);
+					tracking.track(inputs, 2, length);
+
+					worstEnvelope = std::max(worstEnvelope, (double)std::abs(processing.getEnvelopeDecibels() - tracking.getEnvelopeDecibels()));
+					worstMakeup = std::max(worstMakeup, (double)std::abs(processing.getMakeupDecibels() - tracking.getMakeupDecibels()));
+				}
+
+				const auto name = "makeup mode " + std::to_string((int)autoMakeup) + ", eco " + std::to_string(controlInterval) + ": track() ";
+				checkNear(name + "envelope follows process()", worstEnvelope, 0.0, 0.01);
+				checkNear(name + "makeup follows process()", worstMakeup, 0.0, 0.01);
+			}
+		}
+	}
+
+	void testDryMix()
+	{
+		Dsp::Compressor compressor;
+		compressor.setParameters({ -40.f, 0.f, 20.f, 20.f, 100.f, 12.f, 0.f });
+		compressor.prepare(sampleRate, blockSize, 1);
+
+		const auto output = processConstant(compressor, { 0.5f }, blockSize * 4);
+		checkNear("mix 0 passes the input through", output[0], 0.5, 1.0e-6);
+	}
+
+	// Worst change of gain from one sample to the next after a 0.01 -> 0.9 step, switching the control
+	// interval from one value to another switchAfter samples into the attack
+	double getWorstGainStep(int fromInterval, int toInterval, int switchAfter)
+	{
+		Dsp::Compressor compressor;
+		compressor.setParameters({ -40.f, 0.f, 20.f, 5.f, 100.f, 0.f, 1.f });
+		compressor.prepare(sampleRate, blockSize, 1);
+		compressor.setControlInterval(fromInterval);
+
+		const auto stepAt = 4800, numSamples = 9600;
+		std::vector<float> input((size_t)numSamples), output;
+
+		for (int i = 0; i < numSamples; ++i)
+			input[(size_t)i] = i < stepAt ? 0.01f : 0.9f;
+
+		output = input;
+		auto position = 0;
+
+		const auto processUntil = [&](int end)
+		{
+			for (; position < end; position += std::min(blockSize, end - position))
+			{
+				float* channels[]{ output.data() + position };
+				compressor.process(channels, 1, std::min(blockSize, end - position));
+			}
+		};
+
+		processUntil(stepAt + switchAfter);
+		compressor.setControlInterval(toInterval);
+		processUntil(numSamples);
+
+		auto worst = 0.0;
+
+		for (int i = stepAt + 1; i < numSamples; ++i)
+			worst = std::max(worst, std::abs(toDecibels(((double)output[(size_t)i] / input[(size_t)i]) / ((double)output[(size_t)i - 1] / input[(size_t)i - 1]))));
+
+		return worst;
+	}
+
+	// A finer interval takes over from the old one's lagging ramp without a jump in gain reduction
+	void testIntervalSwitch()
+	{
+		const auto fullRate = getWorstGainStep(1, 1, 1);
+		const int switches[][2]{ { 32, 1 }, { 4, 1 }, { 8, 4 }, { 16, 8 }, { 32, 16 } };
+
+		for (const auto& interval : switches)
+		{
+			auto worst = 0.0;
+
+			for (int switchAfter = 1; switchAfter < 400; switchAfter += 7)
+				worst = std::max(worst, getWorstGainStep(interval[0], interval[1], switchAfter));
+
+			check(worst <= 2.5 * fullRate, "eco " + std::to_string(interval[0]) + " -> " + std::to_string(interval[1])
+				+ " keeps the gain step within 2.5x the full rate's", worst, 2.5 * fullRate);
+		}
+	}
+
+	// The steepest curve asks for more makeup than the dB tables leave above the Gain setting
+	void testMakeupLimit()
+	{
+		Dsp::Compressor compressor;
+		compressor.setParameters({ -60.f, 0.f, 100.f, 20.f, 100.f, 36.f, 1.f });
+		compressor.setAutoMakeup(Dsp::AutoMakeup::curve);
+		compressor.prepare(sampleRate, blockSize, 1);
+
+		checkNear("curve makeup stops where it and Gain reach the table limit", compressor.getMakeupDecibels(), 12.0, 1.0e-6);
+
+		const auto output = processConstant(compressor, { 1.0e-3f }, blockSize * 4);
+		checkNear("gain at the makeup limit", toDecibels(output[0] / 1.0e-3), 48.0, 0.01);
+	}
+
+	// NaN and Inf mid-stream, in sound and in silence, come out as silence and leave the envelope
+	// where zeros in their place would have
+	void testNonFiniteInput()
+	{
+		const auto numSamples = 48000;
+		const std::pair<int, float> faults[]{ { 1000, std::numeric_limits<float>::quiet_NaN() }, { 5000, std::numeric_limits<float>::infinity() },
+			{ 9001, -std::numeric_limits<float>::infinity() }, { 30000, std::numeric_limits<float>::quiet_NaN() } };
+
+		for (const auto controlInterval : { 1, 32 })
+		{
+			std::vector<float> clean((size_t)numSamples);
+
+			for (int i = 0; i < numSamples; ++i)
+				clean[(size_t)i] = i >= 24000 && i < 36000 ? 0.f : 0.5f * (float)std::sin(2.0 * 3.141592653589793 * 1000.0 * i / sampleRate);
+
+			for (const auto& fault : faults)
+				clean[(size_t)fault.first] = 0.f;
+
+			auto faulty = clean;
+
+			for (const auto& fault : faults)
+				faulty[(size_t)fault.first] = fault.second;
+
+			Dsp::Compressor reference, compressor;
+
+			for (auto* each : { &reference, &compressor })
+			{
+				each->setParameters({ -30.f, 0.f, 8.f, 5.f, 50.f, 0.f, 1.f });
+				each->setControlInterval(controlInterval);
+				each->prepare(sampleRate, blockSize, 1);
+			}
+
+			auto allFinite = true;
+			auto maxDifference = 0.0, maxEnvelopeDifference = 0.0;
+
+			for (int done = 0; done < numSamples; done += blockSize)
+			{
+				const auto length = std::min(blockSize, numSamples - done);
+				float* cleanChannels[]{ clean.data() + done };
+				float* faultyChannels[]{ faulty.data() + done };
+				reference.process(cleanChannels, 1, length);
+				compressor.process(faultyChannels, 1, length);
+
+				for (int i = done; i < done + length; ++i)
+				{
+					allFinite = allFinite && std::isfinite(faulty[(size_t)i]);
+					maxDifference = std::max(maxDifference, (double)std::abs(faulty[(size_t)i] - clean[(size_t)i]));
+				}
+
+				maxEnvelopeDifference = std::max(maxEnvelopeDifference, (double)std::abs(compressor.getEnvelopeDecibels() - reference.getEnvelopeDecibels()));
+			}
+
+			const auto name = "eco " + std::to_string(controlInterval) + ": ";
+			const auto faultCounts = compressor.getFaultCounts();
+
+			check(allFinite, name + "NaN and Inf never reach the output", allFinite, 1.0);
+			check(faultCounts.nonFiniteSamples == std::size(faults), name + "every NaN and Inf is counted", (double)faultCounts.nonFiniteSamples, (double)std::size(faults));
+			check(faultCounts.stateResets == 0, name + "the state never goes non-finite", (double)faultCounts.stateResets, 0.0);
+			checkNear(name + "the output matches zeros in their place", maxDifference, 0.0, 1.0e-6);
+			checkNear(name + "the envelope matches zeros in their place", maxEnvelopeDifference, 0.0, 1.0e-4);
+		}
+	}
+
+	std::vector<float> makeSine(int numSamples, double frequency, double decibels)
+	{
+		std::vector<float> sine((size_t)numSamples);
+		const auto amplitude = std::pow(10.0, decibels / 20.0);
+
+		for (int i = 0; i < numSamples; ++i)
+			sine[(size_t)i] = (float)(amplitude * std::sin(2.0 * 3.141592653589793 * frequency * i / sampleRate));
+
+		return sine;
+	}
+
+	// The mean square of every step a meter takes from the channels, fed a block at a time
+	std::vector<double> getLoudnessSteps(const std::vector<const float*>& channels, int numSamples)
+	{
+		Dsp::KWeightedMeter meter;
+		meter.prepare(sampleRate, (int)channels.size());
+		std::vector<double> steps;
+
+		for (int done = 0; done < numSamples; done += blockSize)
+		{
+			std::vector<const float*> block;
+
+			for (auto* channel : channels)
+				block.push_back(channel + done);
+
+			meter.process(block.data(), std::min(blockSize, numSamples - done));
+
+			for (int i = 0; i < meter.getSteps().count; ++i)
+				steps.push_back(meter.getSteps().meanSquare[(size_t)i]);
+		}
+
+		return steps;
+	}
+
+	double getIntegratedLoudness(const std::vector<double>& steps)
+	{
+		Dsp::LoudnessGate gate;
+
+		for (const auto step : steps)
+			gate.addStep(step);
+
+		return gate.getIntegrated();
+	}
+
+	// BS.1770 puts a 1 kHz sine at -23 dBFS in both stereo channels at -23 LUFS, and the relative
+	// gate, 10 LU under the ungated level, leaves a quiet passage out of the integrated loudness
+	void testLoudness()
+	{
+		const auto numSamples = 20 * (int)sampleRate;
+		const auto sine = makeSine(numSamples, 1000.0, -23.0);
+		const auto steps = getLoudnessSteps({ sine.data(), sine.data() }, numSamples);
+
+		checkNear("1 kHz at -23 dBFS in stereo reads -23 LUFS", getIntegratedLoudness(steps), -23.0, 0.1);
+
+		Dsp::LoudnessGate gate;
+
+		for (const auto step : steps)
+			gate.addStep(step);
+
+		checkNear("momentary of a steady sine", gate.getMomentary(), -23.0, 0.1);
+		checkNear("short-term of a steady sine", gate.getShortTerm(), -23.0, 0.1);
+
+		// 10 s at -23 then 10 s at -45; ungated the two would read about -26 LUFS
+		auto programme = sine;
+		const auto quiet = makeSine(numSamples, 1000.0, -45.0);
+		std::copy(quiet.begin() + numSamples / 2, quiet.end(), programme.begin() + numSamples / 2);
+
+		const auto gated = getIntegratedLoudness(getLoudnessSteps({ programme.data(), programme.data() }, numSamples));
+		checkNear("the relative gate leaves out a passage 22 LU down", gated, -23.0, 0.1);
+	}
+
+	// Stereo fills both lanes of an SSE2 register where it has one; either way a stereo step is the
+	// sum of the two channels measured alone, which always take the scalar path
+	void testLoudnessStereoPath()
+	{
+		const auto numSamples = 5 * (int)sampleRate;
+		const auto left = makeSine(numSamples, 997.0, -12.0);
+		auto right = makeSine(numSamples, 61.0, -6.0);
+
+		for (int i = 0; i < numSamples; i += 3)
+			right[(size_t)i] += 0.25f * (float)((i * 7919) % 1000 - 500) / 500.f;
+
+		const auto stereo = getLoudnessSteps({ left.data(), right.data() }, numSamples);
+		const auto leftAlone = getLoudnessSteps({ left.data() }, numSamples);
+		const auto rightAlone = getLoudnessSteps({ right.data() }, numSamples);
+
+		check(stereo.size() == 50 && leftAlone.size() == 50 && rightAlone.size() == 50, "stereo and mono take the same steps", (double)stereo.size(), 50.0);
+		auto worst = 0.0;
+
+		for (size_t i = 0; i < std::min({ stereo.size(), leftAlone.size(), rightAlone.size() }); ++i)
+			worst = std::max(worst, std::abs(stereo[i] / (leftAlone[i] + rightAlone[i]) - 1.0));
+
+		checkNear("stereo steps match the channels measured alone", worst, 0.0, 1.0e-6);
+	}
+
+	// Blocks that take their whole deadline step the level down; fewer levels pull it back
+	void testAdaptiveQualityRange()
+	{
+		Dsp::AdaptiveQuality quality(5);
+		quality.prepare(sampleRate);
+
+		// The first step waits out minimumStepSeconds, 50 ms
+		const auto blockSeconds = blockSize / sampleRate;
+
+		for (int i = 0; i < 5; ++i)
+			quality.update(blockSize, blockSeconds);
+
+		check(quality.getLevel() == 1, "an overrun steps down a level", quality.getLevel(), 1.0);
+
+		quality.setNumLevels(1);
+		check(quality.getLevel() == 0, "a smaller range pulls the level back", quality.getLevel(), 0.0);
+
+		for (int i = 0; i < 100; ++i)
+			quality.update(blockSize, blockSeconds);
+
+		check(quality.getLevel() == 0, "no steps past the range", quality.getLevel(), 0.0);
+		check(quality.getDowngrades() == 1, "only real steps count as downgrades", (double)quality.getDowngrades(), 1.0);
+	}
+}
+
+int main()
+{
+	testTransferCurve();
+	testSettledGain();
+	testLinkedDetector();
+	testAttack();
+	testRelease();
+	testCountReset();
+	testEcoCatchesPeaks();
+	testBlockSplits();
+	testTrackMatchesProcess();
+	testDryMix();
+	testMakeupLimit();
+	testIntervalSwitch();
+	testNonFiniteInput();
+	testLoudness();
+	testLoudnessStereoPath();
+	testAdaptiveQualityRange();
+
+	std::cout << (numFailed == 0 ? "all tests passed\n" : std::to_string(numFailed) + " tests failed\n");
+	return numFailed == 0 ? 0 : 1;
+}
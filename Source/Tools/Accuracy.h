@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+	Compares a production processing path against Dsp::ReferenceCompressor,
+	JUCE-free.
+
+	Figures per signal:
+		maxDeviationDb   largest level difference on any sample above -100 dBFS
+		maxOvershootDb   largest amount by which the production output is
+		                 louder than the reference, on the same samples
+		nullDepthDb      residual energy relative to the reference output
+		attack/release   how far apart the two gain reduction curves cross
+		errorMs          63% of the way to their settled value after each
+		                 step in a signal's level (tone bursts only)
+
+	Gain reduction is read back from output / input on both sides, so the
+	production path needs no hooks into its internals.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+#include "TestSignals.h"
+#include "../Dsp/ReferenceCompressor.h"
+
+namespace Tools
+{
+	struct AccuracyReport
+	{
+		double maxDeviationDb{}, maxOvershootDb{};
+		double nullDepthDb{ -std::numeric_limits<double>::infinity() };
+		double attackErrorMs{ std::numeric_limits<double>::quiet_NaN() };
+		double releaseErrorMs{ std::numeric_limits<double>::quiet_NaN() };
+	};
+
+	namespace AccuracyDetail
+	{
+		// Envelope in dB recovered from one channel's output / input, NaN where the input is too quiet to tell
+		template <typename Sample>
+		std::vector<double> recoverGainReduction(const std::vector<float>& input, const Sample* output, const ChainSettings& settings)
+		{
+			constexpr double inputFloor{ 1.0e-4 };
+			std::vector<double> gainReduction(input.size(), std::numeric_limits<double>::quiet_NaN());
+
+			for (size_t i = 0; i < input.size(); ++i)
+			{
+				if (std::abs((double)input[i]) < inputFloor || settings.mix <= 0.f)
+					continue;
+
+				const auto factor = (double)output[i] / (double)input[i];
+				const auto wet = (factor - 1.0 + (double)settings.mix) / (double)settings.mix;
+
+				if (wet > 0.0)
+					gainReduction[i] = 20.0 * std::log10(wet) - (double)settings.gain;
+			}
+
+			return gainReduction;
+		}
+
+		// First sample from start on whose gain reduction has gone fraction of the way from 'from' to 'to'
+		inline int findCrossing(const std::vector<double>& gainReduction, int start, int end, double from, double to, double fraction)
+		{
+			const auto level = from + fraction * (to - from);
+			const auto falling = to < from;
+
+			for (auto i = start; i < end; ++i)
+			{
+				const auto value = gainReduction[(size_t)i];
+
+				if (!std::isnan(value) && (falling ? value <= level : value >= level))
+					return i;
+			}
+
+			return end;
+		}
+	}
+
+	// process(float* const* channels, int numChannels, int numSamples) runs the production path in place.
+	// It is fed blockSize samples at a time, from a freshly reset state.
+	template <typename Process>
+	AccuracyReport measureAccuracy(const TestSignal& signal, const ChainSettings& settings, int blockSize, Process&& process)
+	{
+		const auto numChannels = (int)signal.channels.size();
+		const auto numSamples = signal.getNumSamples();
+
+		auto produced = signal.channels;
+		std::vector<std::vector<double>> expected((size_t)numChannels, std::vector<double>((size_t)numSamples));
+		std::vector<double> referenceGainReduction((size_t)numSamples);
+
+		std::vector<float*> producedPointers;
+		std::vector<const float*> inputPointers;
+		std::vector<double*> expectedPointers;
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			producedPointers.push_back(produced[(size_t)channel].data());
+			inputPointers.push_back(signal.channels[(size_t)channel].data());
+			expectedPointers.push_back(expected[(size_t)channel].data());
+		}
+
+		Dsp::ReferenceCompressor reference;
+		reference.setParameters(settings);
+		reference.prepare(signal.sampleRate);
+		reference.process(inputPointers.data(), expectedPointers.data(), numChannels, numSamples, referenceGainReduction.data());
+
+		std::vector<float*> block((size_t)numChannels);
+
+		for (int offset = 0; offset < numSamples; offset += blockSize)
+		{
+			for (int channel = 0; channel < numChannels; ++channel)
+				block[(size_t)channel] = producedPointers[(size_t)channel] + offset;
+
+			process(block.data(), numChannels, std::min(blockSize, numSamples - offset));
+		}
+
+		AccuracyReport report;
+		double residualEnergy{}, referenceEnergy{};
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			for (int i = 0; i < numSamples; ++i)
+			{
+				const auto y = (double)produced[(size_t)channel][(size_t)i];
+				const auto yRef = expected[(size_t)channel][(size_t)i];
+
+				residualEnergy += (y - yRef) * (y - yRef);
+				referenceEnergy += yRef * yRef;
+
+				if (std::abs(yRef) > 1.0e-5)
+				{
+					const auto deviation = 20.0 * std::log10(std::abs(y) / std::abs(yRef));
+					report.maxDeviationDb = std::max(report.maxDeviationDb, std::abs(deviation));
+					report.maxOvershootDb = std::max(report.maxOvershootDb, deviation);
+				}
+			}
+		}
+
+		if (residualEnergy > 0.0 && referenceEnergy > 0.0)
+			report.nullDepthDb = 10.0 * std::log10(residualEnergy / referenceEnergy);
+
+		if (!signal.onsets.empty())
+		{
+			const auto producedGainReduction = AccuracyDetail::recoverGainReduction(signal.channels[0], produced[0].data(), settings);
+			const auto expectedGainReduction = AccuracyDetail::recoverGainReduction(signal.channels[0], expected[0].data(), settings);
+			const auto samplesToMs = 1000.0 / signal.sampleRate;
+
+			report.attackErrorMs = report.releaseErrorMs = 0.0;
+
+			for (size_t burst = 0; burst < signal.onsets.size(); ++burst)
+			{
+				const auto onset = signal.onsets[burst], offset = signal.offsets[burst];
+				const auto next = burst + 1 < signal.onsets.size() ? signal.onsets[burst + 1] : numSamples;
+
+				// Settled values are taken from the exact reference envelope on both sides, so only timing differs
+				const auto before = referenceGainReduction[(size_t)std::max(onset - 1, 0)];
+				const auto peak = referenceGainReduction[(size_t)offset - 1];
+				const auto after = referenceGainReduction[(size_t)next - 1];
+
+				if (std::abs(peak - before) < 0.1)
+					continue;
+
+				const auto attack = [&](const std::vector<double>& curve) { return AccuracyDetail::findCrossing(curve, onset, offset, before, peak, 0.632); };
+				const auto release = [&](const std::vector<double>& curve) { return AccuracyDetail::findCrossing(curve, offset, next, peak, after, 0.632); };
+
+				report.attackErrorMs = std::max(report.attackErrorMs, std::abs(attack(producedGainReduction) - attack(expectedGainReduction)) * samplesToMs);
+				report.releaseErrorMs = std::max(report.releaseErrorMs, std::abs(release(producedGainReduction) - release(expectedGainReduction)) * samplesToMs);
+			}
+		}
+
+		return report;
+	}
+
+	// Runs the signal through process, fed in blocks whose sizes cycle through blockSizes
+	template <typename Process>
+	std::vector<std::vector<float>> renderInBlocks(const TestSignal& signal, const std::vector<int>& blockSizes, Process&& process)
+	{
+		auto produced = signal.channels;
+		const auto numSamples = signal.getNumSamples();
+		std::vector<float*> block(produced.size());
+
+		for (int offset = 0, next = 0; offset < numSamples; next = (next + 1) % (int)blockSizes.size())
+		{
+			const auto length = std::min(blockSizes[(size_t)next], numSamples - offset);
+
+			for (size_t channel = 0; channel < produced.size(); ++channel)
+				block[channel] = produced[channel].data() + offset;
+
+			process(block.data(), (int)produced.size(), length);
+			offset += length;
+		}
+
+		return produced;
+	}
+
+	// Largest level difference between two renders of one signal, on samples above -100 dBFS
+	inline double measureDifferenceDb(const std::vector<std::vector<float>>& a, const std::vector<std::vector<float>>& b)
+	{
+		auto maxDifferenceDb = 0.0;
+
+		for (size_t channel = 0; channel < a.size(); ++channel)
+			for (size_t i = 0; i < a[channel].size(); ++i)
+				if (std::abs(a[channel][i]) > 1.0e-5f)
+					maxDifferenceDb = std::max(maxDifferenceDb, std::abs(20.0 * std::log10(std::abs((double)b[channel][i] / (double)a[channel][i]))));
+
+		return maxDifferenceDb;
+	}
+}
@@ -0,0 +1,192 @@
+/*
+  ==============================================================================
+
+	CompressorV2Accuracy: checks Dsp::Compressor against the double precision
+	reference model and fails if any limit is exceeded.
+
+	CompressorV2Accuracy [--block <n>] [--format text|csv]
+	                     [--max-deviation <dB>] [--max-timing <ms>] [--min-null <dB>]
+	                     [--max-overshoot <dB>] [--max-split <dB>]
+
+	Renders the standard test signals (sweep, tone bursts, pink noise,
+	transients) in mono and stereo at 44.1 and 96 kHz, through a set of
+	parameter regimes, at the full rate and at every eco interval. Run it
+	before merging any change to a DSP kernel; the exit code is 0 when
+	every case is within the limits.
+
+	The full rate is held to the reference by deviation, null depth and
+	timing. Eco reads the detector's maximum over each interval, so it
+	compresses tones and noise harder than the per-sample reference by
+	design; it is held to never letting anything through more than
+	--max-overshoot louder than the reference instead. Every case is also
+	rendered again in irregular blocks, down to single samples, and must
+	match its first render within --max-split.
+
+  ==============================================================================
+*/
+
+#include "Accuracy.h"
+#include "../Dsp/Compressor.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Regime
+	{
+		const char* name;
+		ChainSettings settings;
+	};
+
+	const Regime regimes[]
+	{
+		{ "moderate", { -18.f, 0.6f, 4.f, 20.f, 100.f, 0.f, 1.f } },
+		{ "softKnee", { -24.f, 12.f, 3.f, 20.f, 250.f, 6.f, 1.f } },
+		{ "limiting", { -30.f, 0.f, 100.f, 20.f, 50.f, 18.f, 1.f } },
+		{ "parallel", { -40.f, 0.f, 20.f, 20.f, 500.f, 12.f, 0.5f } },
+	};
+
+	const int controlIntervals[] { 1, 4, 8, 16, 32 };
+
+	void printUsage()
+	{
+		std::cerr << "Usage: CompressorV2Accuracy [--block <n>] [--format text|csv]\n"
+			"                            [--max-deviation <dB>] [--max-timing <ms>] [--min-null <dB>]\n"
+			"                            [--max-overshoot <dB>] [--max-split <dB>]\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	auto blockSize = 512;
+	std::string format{ "text" };
+
+	// Defaults leave room for the table based dB conversions, which are good to about 1e-3 dB
+	auto maxDeviationDb = 0.01;
+	auto maxTimingMs = 0.1;
+	auto minNullDb = -70.0;
+	auto maxOvershootDb = 1.0;
+	auto maxSplitDb = 1.0e-3;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg(argv[i]);
+		const auto hasValue = i + 1 < argc;
+
+		if (arg == "--block" && hasValue)
+			blockSize = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--format" && hasValue)
+			format = argv[++i];
+		else if (arg == "--max-deviation" && hasValue)
+			maxDeviationDb = std::atof(argv[++i]);
+		else if (arg == "--max-timing" && hasValue)
+			maxTimingMs = std::atof(argv[++i]);
+		else if (arg == "--min-null" && hasValue)
+			minNullDb = std::atof(argv[++i]);
+		else if (arg == "--max-overshoot" && hasValue)
+			maxOvershootDb = std::atof(argv[++i]);
+		else if (arg == "--max-split" && hasValue)
+			maxSplitDb = std::atof(argv[++i]);
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	const auto csv = format == "csv";
+	auto numFailed = 0;
+
+	// Block boundaries everywhere relative to the grid, including larger than the prepared size
+	const std::vector<int> irregularBlocks{ 100, 1, 37, blockSize, 3, 2 * blockSize + 7, 250 };
+
+	if (csv)
+		std::cout << "signal,regime,sampleRate,channels,controlInterval,maxDeviationDb,maxOvershootDb,nullDepthDb,attackErrorMs,releaseErrorMs,splitDeviationDb,pass\n";
+	else
+		std::cout << std::fixed << std::setprecision(4);
+
+	for (auto sampleRate : { 44100.0, 96000.0 })
+	{
+		for (auto numChannels : { 1, 2 })
+		{
+			for (const auto& signal : Tools::Signals::makeStandardSet(sampleRate, numChannels))
+			{
+				for (const auto& regime : regimes)
+				{
+					for (auto controlInterval : controlIntervals)
+					{
+						auto makeCompressor = [&]
+						{
+							auto compressor = std::make_unique<Dsp::Compressor>();
+							compressor->setParameters(regime.settings);
+							compressor->setControlInterval(controlInterval);
+							compressor->prepare(sampleRate, blockSize, numChannels);
+							return compressor;
+						};
+
+						auto compressor = makeCompressor();
+						const auto report = Tools::measureAccuracy(signal, regime.settings, blockSize, [&](float* const* channels, int n, int numSamples)
+						{
+							compressor->process(channels, n, numSamples);
+						});
+
+						auto render = [&](const std::vector<int>& blockSizes)
+						{
+							auto fresh = makeCompressor();
+							return Tools::renderInBlocks(signal, blockSizes, [&](float* const* channels, int n, int numSamples)
+							{
+								fresh->process(channels, n, numSamples);
+							});
+						};
+
+						const auto splitDeviationDb = Tools::measureDifferenceDb(render({ blockSize }), render(irregularBlocks));
+						const auto eco = controlInterval > 1;
+
+						// NaN timing (no bursts in the signal) compares false, so it passes
+						const auto pass = splitDeviationDb <= maxSplitDb && (eco
+							? report.maxOvershootDb <= maxOvershootDb
+							: report.maxDeviationDb <= maxDeviationDb && report.nullDepthDb <= minNullDb
+								&& !(report.attackErrorMs > maxTimingMs) && !(report.releaseErrorMs > maxTimingMs));
+
+						if (!pass)
+							++numFailed;
+
+						if (csv)
+						{
+							std::cout << signal.name << "," << regime.name << "," << sampleRate << "," << numChannels << "," << controlInterval << ","
+								<< report.maxDeviationDb << "," << report.maxOvershootDb << "," << report.nullDepthDb << "," << report.attackErrorMs << ","
+								<< report.releaseErrorMs << "," << splitDeviationDb << "," << (pass ? 1 : 0) << "\n";
+						}
+						else
+						{
+							std::cout << std::left << std::setw(11) << signal.name << std::setw(9) << regime.name
+								<< std::right << std::setw(7) << (int)sampleRate << " Hz " << numChannels << "ch"
+								<< (eco ? "  eco " : "  full") << std::setw(3) << (eco ? std::to_string(controlInterval) : "");
+
+							if (eco)
+								std::cout << "  overshoot " << report.maxOvershootDb << " dB";
+							else
+								std::cout << "  deviation " << report.maxDeviationDb << " dB  null " << std::setprecision(1) << report.nullDepthDb << " dB";
+
+							if (!eco && !signal.onsets.empty())
+								std::cout << std::setprecision(3) << "  attack " << report.attackErrorMs << " ms  release " << report.releaseErrorMs << " ms";
+
+							std::cout << std::setprecision(6) << "  split " << splitDeviationDb << " dB";
+							std::cout << std::setprecision(4) << (pass ? "" : "  FAIL") << "\n";
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (!csv)
+		std::cout << (numFailed == 0 ? "all cases within limits\n" : std::to_string(numFailed) + " cases out of limits\n");
+
+	return numFailed == 0 ? 0 : 1;
+}
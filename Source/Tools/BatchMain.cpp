@@ -0,0 +1,255 @@
+/*
+  ==============================================================================
+
+	CompressorV2Batch: renders audio files through the compressor offline.
+
+	CompressorV2Batch --out <dir> [--preset <file>] [--jobs <n>] [--block <n>]
+	                  [--raw <channels>:<rate>] [--no-mmap]
+	                  [--split <seconds> [--tolerance <dB>] [--verify]] <input>...
+
+	The preset is a file holding the plugin's getStateInformation() data.
+	Files are spread over a work-stealing pool with one processor instance
+	per worker. Outputs keep the input's name and format; the batch is
+	refused before anything is rendered if two inputs share a name or an
+	output would land on one of the inputs.
+
+	With --split, files are rendered one at a time and each is cut into
+	segments that are rendered in parallel. Every segment pre-rolls the
+	compressor envelope on the audio before it, so the output stays within
+	--tolerance (default 0.01 dB) of a serial render. Segments grow to the
+	length of that pre-roll when it is longer, and a preset with Running
+	auto makeup, which depends on everything before it, renders serially.
+	--verify also renders each file serially and checks the split render
+	against it.
+
+	Float WAV files are memory-mapped rather than decoded, unless --no-mmap
+	is given. Files ending in .raw, .f32 or .pcm are read as headerless
+	little-endian float with the layout given by --raw, e.g. --raw 2:48000.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "OfflineRenderer.h"
+#include "WorkStealingPool.h"
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+
+namespace
+{
+	void printUsage()
+	{
+		std::cout << "Usage: CompressorV2Batch --out <dir> [--preset <file>] [--jobs <n>] [--block <n>]\n"
+			"                         [--raw <channels>:<rate>] [--no-mmap]\n"
+			"                         [--split <seconds> [--tolerance <dB>] [--verify]] <input>...\n";
+	}
+
+	void printResult(const juce::File& input, const Tools::RenderResult& result)
+	{
+		if (result.ok)
+			std::cout << input.getFileName() << ": " << juce::String(result.audioSeconds, 1) << " s in "
+				<< juce::String(result.wallSeconds, 2) << " s, " << juce::String(result.getRealTimeFactor(), 1) << "x real time\n";
+		else
+			std::cerr << input.getFileName() << ": " << result.error << "\n";
+	}
+
+	// Same path, or the same file reached through a link
+	bool isSameFile(const juce::File& a, const juce::File& b)
+	{
+		return a == b || (a.existsAsFile() && b.existsAsFile() && a.getFileIdentifier() == b.getFileIdentifier());
+	}
+
+	// One output per input, or an error: writers delete the file they open, so an output must never be an input
+	juce::String planOutputs(const juce::Array<juce::File>& inputs, const juce::File& outputDirectory, juce::Array<juce::File>& outputs)
+	{
+		for (auto& input : inputs)
+		{
+			auto output = outputDirectory.getChildFile(input.getFileName());
+
+			if (outputs.contains(output))
+				return "two inputs would both be written to " + output.getFullPathName();
+
+			for (auto& other : inputs)
+				if (isSameFile(output, other))
+					return "output " + output.getFullPathName() + " would overwrite input " + other.getFullPathName();
+
+			outputs.add(output);
+		}
+
+		return {};
+	}
+
+	int renderSplit(const Tools::OfflineRenderer& renderer, const juce::Array<juce::File>& inputs, const juce::Array<juce::File>& outputs,
+		int numJobs, double segmentSeconds, float toleranceDb, bool verify)
+	{
+		Tools::WorkStealingPool pool(numJobs);
+		std::vector<std::unique_ptr<CompressorV2AudioProcessor>> processors;
+
+		for (int i = 0; i < pool.getNumWorkers(); ++i)
+			processors.push_back(renderer.createProcessor());
+
+		auto numFailed = 0;
+
+		for (int i = 0; i < inputs.size(); ++i)
+		{
+			auto& input = inputs.getReference(i);
+			auto& output = outputs.getReference(i);
+			auto result = renderer.renderFileChunked(processors, pool, input, output, segmentSeconds, toleranceDb);
+			printResult(input, result);
+
+			if (!result.ok)
+			{
+				++numFailed;
+				continue;
+			}
+
+			if (verify)
+			{
+				juce::TemporaryFile reference(output);
+				auto serial = renderer.renderFile(*processors.front(), input, reference.getFile());
+				auto check = serial.ok ? renderer.compareFiles(output, reference.getFile(), toleranceDb) : Tools::VerifyResult{ false, serial.error };
+
+				if (check.error.isNotEmpty())
+					std::cerr << input.getFileName() << ": verify failed, " << check.error << "\n";
+				else
+					std::cout << input.getFileName() << ": " << (check.ok ? "matches" : "DIFFERS FROM") << " serial render within "
+						<< juce::String(toleranceDb, 3) << " dB (max deviation " << juce::String(check.maxDeviationDb, 4)
+						<< " dB, max difference " << juce::String(check.maxDifferenceDb, 1) << " dBFS)\n";
+
+				if (!check.ok)
+					++numFailed;
+			}
+		}
+
+		return numFailed == 0 ? 0 : 1;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+	juce::File outputDirectory, presetFile;
+	juce::Array<juce::File> inputs;
+	auto numJobs = juce::SystemStats::getNumCpus();
+	auto blockSize = 1024;
+	auto segmentSeconds = 0.0;
+	auto toleranceDb = 0.01f;
+	auto verify = false;
+	auto memoryMapping = true;
+	Tools::RawFormat rawFormat;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		juce::String arg(argv[i]);
+		auto hasValue = i + 1 < argc;
+
+		if (arg == "--out" && hasValue)
+			outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+		else if (arg == "--preset" && hasValue)
+			presetFile = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+		else if (arg == "--jobs" && hasValue)
+			numJobs = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+		else if (arg == "--block" && hasValue)
+			blockSize = juce::jmax(16, juce::String(argv[++i]).getIntValue());
+		else if (arg == "--split" && hasValue)
+			segmentSeconds = juce::jmax(0.0, juce::String(argv[++i]).getDoubleValue());
+		else if (arg == "--tolerance" && hasValue)
+			toleranceDb = juce::jmax(1.0e-4f, juce::String(argv[++i]).getFloatValue());
+		else if (arg == "--verify")
+			verify = true;
+		else if (arg == "--no-mmap")
+			memoryMapping = false;
+		else if (arg == "--raw" && hasValue)
+		{
+			juce::String layout(argv[++i]);
+			rawFormat = { layout.upToFirstOccurrenceOf(":", false, false).getIntValue(), layout.fromFirstOccurrenceOf(":", false, false).getDoubleValue() };
+
+			if (!rawFormat.isValid())
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		else if (arg.startsWith("--"))
+		{
+			printUsage();
+			return 1;
+		}
+		else
+			inputs.add(juce::File::getCurrentWorkingDirectory().getChildFile(arg));
+	}
+
+	if (inputs.isEmpty() || outputDirectory == juce::File())
+	{
+		printUsage();
+		return 1;
+	}
+
+	juce::MemoryBlock preset;
+
+	if (presetFile != juce::File() && !presetFile.loadFileAsData(preset))
+	{
+		std::cerr << "Cannot read preset " << presetFile.getFullPathName() << "\n";
+		return 1;
+	}
+
+	juce::Array<juce::File> outputs;
+	auto planError = planOutputs(inputs, outputDirectory, outputs);
+
+	if (planError.isNotEmpty())
+	{
+		std::cerr << "Nothing rendered: " << planError << "\n";
+		return 1;
+	}
+
+	outputDirectory.createDirectory();
+
+	Tools::OfflineRenderer renderer(preset, blockSize);
+	renderer.setMemoryMappingEnabled(memoryMapping);
+	renderer.setRawFormat(rawFormat);
+
+	if (segmentSeconds > 0.0)
+		return renderSplit(renderer, inputs, outputs, numJobs, segmentSeconds, toleranceDb, verify);
+
+	Tools::WorkStealingPool pool(juce::jmin(numJobs, inputs.size()));
+
+	// Processors are created here, on the message thread, then each is only touched by its worker
+	std::vector<std::unique_ptr<CompressorV2AudioProcessor>> processors;
+
+	for (int i = 0; i < pool.getNumWorkers(); ++i)
+		processors.push_back(renderer.createProcessor());
+
+	std::mutex outputLock;
+	std::atomic<int> numFailed{};
+	std::atomic<double> totalAudioSeconds{};
+	std::vector<Tools::WorkStealingPool::Job> jobs;
+
+	for (int i = 0; i < inputs.size(); ++i)
+	{
+		jobs.push_back([&, input = inputs[i], output = outputs[i]](int worker)
+		{
+			auto result = renderer.renderFile(*processors[(size_t)worker], input, output);
+
+			std::lock_guard<std::mutex> guard(outputLock);
+			printResult(input, result);
+
+			if (result.ok)
+				totalAudioSeconds.store(totalAudioSeconds.load() + result.audioSeconds);
+			else
+				++numFailed;
+		});
+	}
+
+	auto startTicks = juce::Time::getHighResolutionTicks();
+	pool.run(std::move(jobs));
+	auto wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+	std::cout << inputs.size() - numFailed.load() << " files, " << juce::String(totalAudioSeconds.load(), 1) << " s of audio in "
+		<< juce::String(wallSeconds, 2) << " s on " << pool.getNumWorkers() << " workers, "
+		<< juce::String(wallSeconds > 0.0 ? totalAudioSeconds.load() / wallSeconds : 0.0, 1) << "x real time\n";
+
+	return numFailed.load() == 0 ? 0 : 1;
+}
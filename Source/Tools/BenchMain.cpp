@@ -0,0 +1,540 @@
+/*
+  ==============================================================================
+
+	CompressorV2Bench: times the DSP core, and the processor when built with JUCE.
+
+	CompressorV2Bench [--format json|csv] [--out <file>] [--label <text>]
+	                  [--min-time <seconds>] [--repeats <n>] [--filter <text>]
+
+	Cases:
+		process        Dsp::Compressor::process() over every block size,
+		               channel count, sample rate and parameter regime
+		detect, gainComputer, envelope, mix, metering
+		               the stages on their own, over block sizes and channel
+		               counts at 48 kHz in the moderate regime
+		processIdle    process() in the moderate regime on digital silence and
+		               on the source 40 dB down, well under the threshold: the
+		               two fast paths, over block sizes and channel counts at 48 kHz
+		processNonFinite
+		               process() in the moderate regime on clean input and on
+		               the same with a NaN and an Inf every 256 samples, what
+		               the passes that mask them out cost, over block sizes
+		               and channel counts at 48 kHz
+		eco            process() at every eco control interval, stereo at 48 kHz
+		               in the moderate regime, plus a "tradeOffs" table of each
+		               interval's speed-up against its worst deviation and null
+		               depth versus the reference model on the standard signals
+		processDouble  process() on double buffers, over block sizes and
+		               channel counts at 48 kHz in the moderate regime
+		processConverted
+		               the same double buffers converted to float for process()
+		               and back, what a 64-bit host does for a float-only plugin
+		copy           the input copy that feeds every in-place case, so it
+		               can be taken off their figures
+		processBlock, processBlockDouble
+		               CompressorV2AudioProcessor::processBlock() in both
+		               precisions over the same matrix as process, for the
+		               layouts the plugin supports (CompressorV2ProcessorBench only)
+		stateLoad      setStateInformation() into 1, 30 and 300 instances, for the
+		               compact format and the legacy ValueTree format; reported
+		               under "timings" (CompressorV2ProcessorBench only)
+
+	--label is stored in the JSON, e.g. a commit hash. --filter keeps the
+	cases whose name contains the text.
+
+  ==============================================================================
+*/
+
+#if COMPRESSORV2_BENCH_PROCESSOR
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+#endif
+
+#include "Accuracy.h"
+#include "Benchmark.h"
+#include "../Dsp/Compressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace
+{
+	struct Regime
+	{
+		const char* name;
+		ChainSettings settings;
+	};
+
+	// No gain reduction, typical bus compression, and heavy parallel compression with makeup
+	const Regime regimes[]
+	{
+		{ "bypass", { 0.f, 0.f, 1.f, 20.f, 20.f, 0.f, 1.f } },
+		{ "moderate", { -18.f, 0.6f, 4.f, 20.f, 100.f, 0.f, 1.f } },
+		{ "heavy", { -40.f, 0.f, 20.f, 20.f, 500.f, 12.f, 0.5f } },
+	};
+
+	const int blockSizes[]{ 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+	const int channelCounts[]{ 1, 2, 8 };
+	const double sampleRates[]{ 44100.0, 48000.0, 96000.0, 192000.0 };
+
+	constexpr int sourceLength{ 1 << 16 };
+
+	// Noise under a slow 3 Hz swell, so the detector keeps crossing the threshold and the knee
+	std::vector<std::vector<float>> makeSource(int numChannels, double sampleRate)
+	{
+		std::vector<std::vector<float>> source((size_t)numChannels, std::vector<float>((size_t)sourceLength));
+		unsigned int seed{ 12345 };
+
+		for (auto& channel : source)
+		{
+			for (int i = 0; i < sourceLength; ++i)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				const auto noise = (float)seed / 4294967296.f * 2.f - 1.f;
+				const auto swell = 0.5f + 0.5f * (float)std::sin(2.0 * 3.14159265358979 * 3.0 * i / sampleRate);
+				channel[(size_t)i] = 0.9f * noise * swell;
+			}
+		}
+
+		return source;
+	}
+
+	// Walks through the source a block at a time, copying each block into the work buffers
+	template <typename SampleType>
+	struct BlockFeeder
+	{
+		BlockFeeder(int numChannels, int blockSize, double sampleRate)
+			: work((size_t)numChannels, std::vector<SampleType>((size_t)blockSize)),
+			size(blockSize)
+		{
+			for (auto& channel : makeSource(numChannels, sampleRate))
+				source.emplace_back(channel.begin(), channel.end());
+
+			for (auto& channel : work)
+				pointers.push_back(channel.data());
+		}
+
+		void next() noexcept
+		{
+			if ((offset += size) + size > sourceLength)
+				offset = 0;
+
+			for (size_t channel = 0; channel < work.size(); ++channel)
+				std::memcpy(work[channel].data(), source[channel].data() + offset, sizeof(SampleType) * (size_t)size);
+		}
+
+		SampleType* const* get() noexcept { return pointers.data(); }
+
+		std::vector<std::vector<SampleType>> source, work;
+		std::vector<SampleType*> pointers;
+		int size, offset{};
+	};
+
+	void runCoreCases(Tools::BenchmarkRunner& runner, const std::string& filter)
+	{
+		auto wanted = [&](const char* name) { return filter.empty() || std::string(name).find(filter) != std::string::npos; };
+
+		if (wanted("process"))
+		{
+			for (const auto& regime : regimes)
+				for (auto sampleRate : sampleRates)
+					for (auto numChannels : channelCounts)
+						for (auto blockSize : blockSizes)
+						{
+							Dsp::Compressor compressor;
+							compressor.setParameters(regime.settings);
+							compressor.prepare(sampleRate, blockSize, numChannels);
+							BlockFeeder<float> feeder(numChannels, blockSize, sampleRate);
+
+							runner.run({ "process", regime.name, blockSize, numChannels, sampleRate }, [&]
+							{
+								feeder.next();
+								compressor.process(feeder.get(), numChannels, blockSize);
+							});
+						}
+		}
+
+		const auto& moderate = regimes[1];
+		constexpr double stageRate{ 48000.0 };
+
+		if (wanted("processIdle"))
+		{
+			const std::pair<const char*, float> levels[]{ { "silence", 0.f }, { "quiet", 0.01f } };
+
+			for (const auto& [levelName, scale] : levels)
+				for (auto numChannels : channelCounts)
+					for (auto blockSize : blockSizes)
+					{
+						Dsp::Compressor compressor;
+						compressor.setParameters(moderate.settings);
+						compressor.prepare(stageRate, blockSize, numChannels);
+						BlockFeeder<float> feeder(numChannels, blockSize, stageRate);
+
+						for (auto& channel : feeder.source)
+							for (auto& sample : channel)
+								sample *= scale;
+
+						runner.run({ "processIdle", levelName, blockSize, numChannels, stageRate }, [&]
+						{
+							feeder.next();
+							compressor.process(feeder.get(), numChannels, blockSize);
+						});
+					}
+		}
+
+		if (wanted("processNonFinite"))
+		{
+			for (auto faulty : { false, true })
+				for (auto numChannels : channelCounts)
+					for (auto blockSize : blockSizes)
+					{
+						Dsp::Compressor compressor;
+						compressor.setParameters(moderate.settings);
+						compressor.prepare(stageRate, blockSize, numChannels);
+						BlockFeeder<float> feeder(numChannels, blockSize, stageRate);
+
+						// The last channel only, so the others keep driving the detector
+						if (faulty)
+						{
+							auto& channel = feeder.source.back();
+
+							for (size_t i = 0; i + 128 < channel.size(); i += 256)
+							{
+								channel[i] = std::numeric_limits<float>::quiet_NaN();
+								channel[i + 128] = -std::numeric_limits<float>::infinity();
+							}
+						}
+
+						runner.run({ "processNonFinite", faulty ? "faulty" : "clean", blockSize, numChannels, stageRate }, [&]
+						{
+							feeder.next();
+							compressor.process(feeder.get(), numChannels, blockSize);
+						});
+					}
+		}
+
+		if (wanted("eco"))
+		{
+			constexpr int numChannels{ 2 }, blockSize{ 512 };
+			const int intervals[]{ 1, 4, 8, 16, 32 };
+			const auto signals = Tools::Signals::makeStandardSet(stageRate, numChannels);
+			double exactNsPerFrame{};
+
+			for (auto interval : intervals)
+			{
+				const auto variant = interval == 1 ? std::string("off") : std::to_string(interval);
+
+				Dsp::Compressor compressor;
+				compressor.setControlInterval(interval);
+				compressor.setParameters(moderate.settings);
+				compressor.prepare(stageRate, blockSize, numChannels);
+				BlockFeeder<float> feeder(numChannels, blockSize, stageRate);
+
+				const auto& timing = runner.run({ "eco", variant, blockSize, numChannels, stageRate }, [&]
+				{
+					feeder.next();
+					compressor.process(feeder.get(), numChannels, blockSize);
+				});
+
+				if (interval == 1)
+					exactNsPerFrame = timing.nsPerFrame;
+
+				Tools::TradeOffResult tradeOff{ "eco", variant, timing.nsPerFrame, exactNsPerFrame / timing.nsPerFrame };
+				tradeOff.nullDepthDb = -std::numeric_limits<double>::infinity();
+
+				for (const auto& signal : signals)
+				{
+					compressor.reset();
+
+					const auto report = Tools::measureAccuracy(signal, moderate.settings, blockSize, [&](float* const* channels, int n, int numSamples)
+					{
+						compressor.process(channels, n, numSamples);
+					});
+
+					tradeOff.maxDeviationDb = std::max(tradeOff.maxDeviationDb, report.maxDeviationDb);
+					tradeOff.nullDepthDb = std::max(tradeOff.nullDepthDb, report.nullDepthDb);
+				}
+
+				runner.addTradeOff(tradeOff);
+			}
+		}
+
+		// A 64-bit host either hands over double buffers as they are, or converts to float and back around the float path
+		if (wanted("processDouble") || wanted("processConverted"))
+		{
+			for (auto numChannels : channelCounts)
+				for (auto blockSize : blockSizes)
+				{
+					Dsp::Compressor compressor;
+					compressor.setParameters(moderate.settings);
+					compressor.prepare(stageRate, blockSize, numChannels);
+					BlockFeeder<double> feeder(numChannels, blockSize, stageRate);
+
+					if (wanted("processDouble"))
+					{
+						runner.run({ "processDouble", moderate.name, blockSize, numChannels, stageRate }, [&]
+						{
+							feeder.next();
+							compressor.process(feeder.get(), numChannels, blockSize);
+						});
+					}
+
+					if (wanted("processConverted"))
+					{
+						std::vector<std::vector<float>> converted((size_t)numChannels, std::vector<float>((size_t)blockSize));
+						std::vector<float*> pointers;
+
+						for (auto& channel : converted)
+							pointers.push_back(channel.data());
+
+						runner.run({ "processConverted", moderate.name, blockSize, numChannels, stageRate }, [&]
+						{
+							feeder.next();
+
+							for (int channel = 0; channel < numChannels; ++channel)
+								std::copy(feeder.get()[channel], feeder.get()[channel] + blockSize, pointers[(size_t)channel]);
+
+							compressor.process(pointers.data(), numChannels, blockSize);
+
+							for (int channel = 0; channel < numChannels; ++channel)
+								std::copy(pointers[(size_t)channel], pointers[(size_t)channel] + blockSize, feeder.get()[channel]);
+						});
+					}
+				}
+		}
+
+		for (auto numChannels : channelCounts)
+			for (auto blockSize : blockSizes)
+			{
+				Dsp::Compressor compressor;
+				compressor.setParameters(moderate.settings);
+				compressor.prepare(stageRate, blockSize, numChannels);
+				BlockFeeder<float> feeder(numChannels, blockSize, stageRate);
+
+				// Run the whole chain once so every stage starts from realistic scratch contents
+				feeder.next();
+				compressor.process(feeder.get(), numChannels, blockSize);
+
+				const Tools::BenchmarkCase stageCase{ "", moderate.name, blockSize, numChannels, stageRate };
+				auto named = [&](const char* name) { auto c = stageCase; c.name = name; return c; };
+
+				if (wanted("copy"))
+					runner.run(named("copy"), [&] { feeder.next(); });
+
+				if (wanted("detect"))
+					runner.run(named("detect"), [&] { compressor.detect(feeder.get(), numChannels, blockSize); });
+
+				if (wanted("gainComputer"))
+					runner.run(named("gainComputer"), [&] { compressor.computeGain(blockSize); });
+
+				if (wanted("envelope"))
+					runner.run(named("envelope"), [&] { Tools::keepAlive(compressor.smoothEnvelope(blockSize)); });
+
+				if (wanted("mix"))
+				{
+					runner.run(named("mix"), [&]
+					{
+						feeder.next();
+						compressor.applyGain(feeder.get(), numChannels, blockSize, -6.f);
+					});
+				}
+
+				if (wanted("metering"))
+				{
+					std::vector<float> factors((size_t)blockSize, 0.5f);
+
+					runner.run(named("metering"), [&]
+					{
+						feeder.next();
+
+						for (int channel = 0; channel < numChannels; ++channel)
+							Tools::keepAlive(Dsp::applyAndMeasure(feeder.get()[channel], factors.data(), blockSize));
+					});
+				}
+			}
+	}
+
+#if COMPRESSORV2_BENCH_PROCESSOR
+	void runProcessorCases(Tools::BenchmarkRunner& runner, const std::string& filter)
+	{
+		if (!filter.empty() && std::string("processBlockDouble").find(filter) == std::string::npos)
+			return;
+
+		for (const auto& regime : regimes)
+			for (auto sampleRate : sampleRates)
+				for (auto numChannels : channelCounts)
+					for (auto blockSize : blockSizes)
+					{
+						CompressorV2AudioProcessor processor;
+						processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+
+						if (processor.getTotalNumInputChannels() != numChannels)
+							continue;
+
+						const auto& s = regime.settings;
+						const std::pair<const char*, float> values[]{ { "Threshold", s.threshold }, { "Knee", s.knee }, { "Ratio", s.ratio },
+							{ "Attack", s.attack }, { "Release", s.release }, { "Gain", s.gain }, { "Mix", s.mix } };
+
+						for (const auto& [id, value] : values)
+							if (auto* parameter = dynamic_cast<juce::RangedAudioParameter*>(processor.apvts.getParameter(id)))
+								parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+
+						processor.prepareToPlay(sampleRate, blockSize);
+
+						juce::MidiBuffer midi;
+
+						{
+							BlockFeeder<float> feeder(numChannels, blockSize, sampleRate);
+							juce::AudioBuffer<float> buffer(feeder.get(), numChannels, blockSize);
+
+							runner.run({ "processBlock", regime.name, blockSize, numChannels, sampleRate }, [&]
+							{
+								feeder.next();
+								processor.processBlock(buffer, midi);
+							});
+						}
+
+						{
+							BlockFeeder<double> feeder(numChannels, blockSize, sampleRate);
+							juce::AudioBuffer<double> buffer(feeder.get(), numChannels, blockSize);
+
+							runner.run({ "processBlockDouble", regime.name, blockSize, numChannels, sampleRate }, [&]
+							{
+								feeder.next();
+								processor.processBlock(buffer, midi);
+							});
+						}
+
+						processor.releaseResources();
+					}
+	}
+
+	void runStateCases(Tools::BenchmarkRunner& runner, const std::string& filter)
+	{
+		if (!filter.empty() && std::string("stateLoad").find(filter) == std::string::npos)
+			return;
+
+		// Two states far enough apart that every load changes every parameter
+		CompressorV2AudioProcessor defaults, edited;
+		const auto& s = regimes[2].settings;
+		const std::pair<const char*, float> values[]{ { "Threshold", s.threshold }, { "Knee", 1.f }, { "Ratio", s.ratio },
+			{ "Attack", 100.f }, { "Release", s.release }, { "Gain", s.gain }, { "Mix", 0.8f } };
+
+		for (const auto& [id, value] : values)
+			if (auto* parameter = dynamic_cast<juce::RangedAudioParameter*>(edited.apvts.getParameter(id)))
+				parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+
+		juce::MemoryBlock compact[2], legacy[2];
+		CompressorV2AudioProcessor* sources[]{ &defaults, &edited };
+
+		for (int i = 0; i < 2; ++i)
+		{
+			sources[i]->getStateInformation(compact[i]);
+
+			juce::MemoryOutputStream stream(legacy[i], false);
+			sources[i]->apvts.copyState().writeToStream(stream);
+		}
+
+		for (auto numInstances : { 1, 30, 300 })
+		{
+			std::vector<std::unique_ptr<CompressorV2AudioProcessor>> instances;
+
+			for (int i = 0; i < numInstances; ++i)
+				instances.push_back(std::make_unique<CompressorV2AudioProcessor>());
+
+			for (auto* states : { compact, legacy })
+			{
+				auto next = 0;
+
+				runner.time("stateLoad", states == compact ? "compact" : "legacy", numInstances, [&]
+				{
+					const auto& state = states[(next++) % 2];
+
+					for (auto& instance : instances)
+						instance->setStateInformation(state.getData(), (int)state.getSize());
+				});
+			}
+		}
+	}
+#endif
+
+	void printUsage()
+	{
+		std::cerr << "Usage: CompressorV2Bench [--format json|csv] [--out <file>] [--label <text>]\n"
+			"                         [--min-time <seconds>] [--repeats <n>] [--filter <text>]\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+#if COMPRESSORV2_BENCH_PROCESSOR
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+#endif
+
+	std::string format{ "json" }, outputPath, label, filter;
+	auto minSeconds = 0.05;
+	auto repeats = 5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg(argv[i]);
+		const auto hasValue = i + 1 < argc;
+
+		if (arg == "--format" && hasValue)
+			format = argv[++i];
+		else if (arg == "--out" && hasValue)
+			outputPath = argv[++i];
+		else if (arg == "--label" && hasValue)
+			label = argv[++i];
+		else if (arg == "--min-time" && hasValue)
+			minSeconds = std::max(0.001, std::atof(argv[++i]));
+		else if (arg == "--repeats" && hasValue)
+			repeats = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--filter" && hasValue)
+			filter = argv[++i];
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	if (format != "json" && format != "csv")
+	{
+		printUsage();
+		return 1;
+	}
+
+	Tools::BenchmarkRunner runner(minSeconds, repeats);
+	runCoreCases(runner, filter);
+
+#if COMPRESSORV2_BENCH_PROCESSOR
+	runProcessorCases(runner, filter);
+	runStateCases(runner, filter);
+#endif
+
+	const auto report = format == "csv" ? runner.toCsv() : runner.toJson(label);
+
+	if (outputPath.empty())
+	{
+		std::cout << report;
+		return 0;
+	}
+
+	std::ofstream output(outputPath);
+	output << report;
+
+	if (!output)
+	{
+		std::cerr << "Cannot write " << outputPath << "\n";
+		return 1;
+	}
+
+	return 0;
+}
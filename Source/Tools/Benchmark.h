@@ -0,0 +1,242 @@
+/*
+  ==============================================================================
+
+	Minimal timing harness for the benchmark tool, JUCE-free.
+
+	A case's body processes one block. The runner first finds how many
+	blocks fill a repeat of minSeconds / numRepeats, then times numRepeats
+	such repeats and keeps the median, which shrugs off the odd preemption.
+	Results are reported per sample frame and against the real-time budget
+	of the case's sample rate, as JSON or CSV for comparing commits.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Tools
+{
+	struct BenchmarkCase
+	{
+		std::string name, regime;
+		int blockSize{}, numChannels{};
+		double sampleRate{};
+	};
+
+	// One-off operations that aren't per sample, e.g. loading state into many instances
+	struct TimingResult
+	{
+		std::string name, variant;
+		int count{};
+		double totalMs{}, usPerItem{};
+	};
+
+	// A cheaper variant of a case measured against its exact one, e.g. the eco control intervals
+	struct TradeOffResult
+	{
+		std::string name, variant;
+		double nsPerFrame{}, speedup{};
+		double maxDeviationDb{}, nullDepthDb{};
+	};
+
+	struct BenchmarkResult
+	{
+		BenchmarkCase benchmarkCase;
+		double nsPerFrame{};        // one sample on every channel
+		double nsPerSample{};       // one sample on one channel
+		double realTimeFactor{};    // how many streams of this case one core could run
+		double dspLoadPercent{};    // share of the real-time budget one stream uses
+	};
+
+	// Keeps a value alive so the optimiser can't drop the work that produced it
+	template <typename T>
+	inline void keepAlive(const T& value) noexcept
+	{
+	   #if defined(__GNUC__)
+		asm volatile("" : : "r,m"(value) : "memory");
+	   #else
+		static volatile char sink;
+		sink = *reinterpret_cast<const volatile char*>(&value);
+		static_cast<void>(sink);
+	   #endif
+	}
+
+	class BenchmarkRunner
+	{
+	public:
+		BenchmarkRunner(double minSecondsPerCase, int repeats)
+			: minSeconds(minSecondsPerCase), numRepeats(std::max(1, repeats))
+		{
+		}
+
+		template <typename Body>
+		const BenchmarkResult& run(const BenchmarkCase& benchmarkCase, Body&& body)
+		{
+			using Clock = std::chrono::steady_clock;
+
+			const auto repeatSeconds = minSeconds / numRepeats;
+			long long blocksPerRepeat{};
+
+			// Calibration doubles as warm-up for caches, branch predictors and clock ramp-up
+			for (auto start = Clock::now(); std::chrono::duration<double>(Clock::now() - start).count() < repeatSeconds; ++blocksPerRepeat)
+				body();
+
+			blocksPerRepeat = std::max(blocksPerRepeat, 1LL);
+
+			std::vector<double> nsPerBlock;
+
+			for (int repeat = 0; repeat < numRepeats; ++repeat)
+			{
+				const auto start = Clock::now();
+
+				for (long long block = 0; block < blocksPerRepeat; ++block)
+					body();
+
+				nsPerBlock.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double)blocksPerRepeat);
+			}
+
+			std::nth_element(nsPerBlock.begin(), nsPerBlock.begin() + numRepeats / 2, nsPerBlock.end());
+
+			BenchmarkResult result;
+			result.benchmarkCase = benchmarkCase;
+			result.nsPerFrame = nsPerBlock[(size_t)numRepeats / 2] / benchmarkCase.blockSize;
+			result.nsPerSample = result.nsPerFrame / std::max(1, benchmarkCase.numChannels);
+
+			const auto framePeriodNs = 1.0e9 / benchmarkCase.sampleRate;
+			result.realTimeFactor = result.nsPerFrame > 0.0 ? framePeriodNs / result.nsPerFrame : 0.0;
+			result.dspLoadPercent = 100.0 * result.nsPerFrame / framePeriodNs;
+
+			results.push_back(result);
+			return results.back();
+		}
+
+		const std::vector<BenchmarkResult>& getResults() const noexcept { return results; }
+
+		// Times numRepeats runs of body, which handles count items, and keeps the median
+		template <typename Body>
+		const TimingResult& time(const std::string& name, const std::string& variant, int count, Body&& body)
+		{
+			using Clock = std::chrono::steady_clock;
+			std::vector<double> ms;
+
+			for (int repeat = 0; repeat < numRepeats; ++repeat)
+			{
+				const auto start = Clock::now();
+				body();
+				ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			}
+
+			std::nth_element(ms.begin(), ms.begin() + numRepeats / 2, ms.end());
+
+			const auto totalMs = ms[(size_t)numRepeats / 2];
+			timings.push_back({ name, variant, count, totalMs, 1000.0 * totalMs / std::max(1, count) });
+			return timings.back();
+		}
+
+		void addTradeOff(const TradeOffResult& tradeOff) { tradeOffs.push_back(tradeOff); }
+
+		std::string toJson(const std::string& label) const
+		{
+			std::ostringstream json;
+			json << "{\n  \"label\": \"" << escape(label) << "\",\n  \"results\": [";
+
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const auto& r = results[i];
+				const auto& c = r.benchmarkCase;
+
+				json << (i == 0 ? "\n" : ",\n")
+					<< "    {\"name\": \"" << escape(c.name) << "\", \"regime\": \"" << escape(c.regime)
+					<< "\", \"blockSize\": " << c.blockSize << ", \"channels\": " << c.numChannels << ", \"sampleRate\": " << c.sampleRate
+					<< ", \"nsPerFrame\": " << r.nsPerFrame << ", \"nsPerSample\": " << r.nsPerSample
+					<< ", \"realTimeFactor\": " << r.realTimeFactor << ", \"dspLoadPercent\": " << r.dspLoadPercent << "}";
+			}
+
+			json << "\n  ],\n  \"timings\": [";
+
+			for (size_t i = 0; i < timings.size(); ++i)
+			{
+				const auto& t = timings[i];
+
+				json << (i == 0 ? "\n" : ",\n")
+					<< "    {\"name\": \"" << escape(t.name) << "\", \"variant\": \"" << escape(t.variant) << "\", \"count\": " << t.count
+					<< ", \"totalMs\": " << t.totalMs << ", \"usPerItem\": " << t.usPerItem << "}";
+			}
+
+			json << "\n  ],\n  \"tradeOffs\": [";
+
+			for (size_t i = 0; i < tradeOffs.size(); ++i)
+			{
+				const auto& t = tradeOffs[i];
+
+				json << (i == 0 ? "\n" : ",\n")
+					<< "    {\"name\": \"" << escape(t.name) << "\", \"variant\": \"" << escape(t.variant)
+					<< "\", \"nsPerFrame\": " << t.nsPerFrame << ", \"speedup\": " << t.speedup
+					<< ", \"maxDeviationDb\": " << t.maxDeviationDb << ", \"nullDepthDb\": " << t.nullDepthDb << "}";
+			}
+
+			json << "\n  ]\n}\n";
+			return json.str();
+		}
+
+		std::string toCsv() const
+		{
+			std::ostringstream csv;
+			csv << "name,regime,blockSize,channels,sampleRate,nsPerFrame,nsPerSample,realTimeFactor,dspLoadPercent\n";
+
+			for (const auto& r : results)
+			{
+				const auto& c = r.benchmarkCase;
+				csv << c.name << "," << c.regime << "," << c.blockSize << "," << c.numChannels << "," << c.sampleRate << ","
+					<< r.nsPerFrame << "," << r.nsPerSample << "," << r.realTimeFactor << "," << r.dspLoadPercent << "\n";
+			}
+
+			// Timings are a different shape, so they get their own table after a blank line
+			if (!timings.empty())
+			{
+				csv << "\nname,variant,count,totalMs,usPerItem\n";
+
+				for (const auto& t : timings)
+					csv << t.name << "," << t.variant << "," << t.count << "," << t.totalMs << "," << t.usPerItem << "\n";
+			}
+
+			if (!tradeOffs.empty())
+			{
+				csv << "\nname,variant,nsPerFrame,speedup,maxDeviationDb,nullDepthDb\n";
+
+				for (const auto& t : tradeOffs)
+					csv << t.name << "," << t.variant << "," << t.nsPerFrame << "," << t.speedup << "," << t.maxDeviationDb << "," << t.nullDepthDb << "\n";
+			}
+
+			return csv.str();
+		}
+
+	private:
+		static std::string escape(const std::string& text)
+		{
+			std::string escaped;
+
+			for (auto character : text)
+			{
+				if (character == '"' || character == '\\')
+					escaped += '\\';
+
+				escaped += character;
+			}
+
+			return escaped;
+		}
+
+		double minSeconds;
+		int numRepeats;
+		std::vector<BenchmarkResult> results;
+		std::vector<TimingResult> timings;
+		std::vector<TradeOffResult> tradeOffs;
+	};
+}
@@ -0,0 +1,174 @@
+/*
+  ==============================================================================
+
+	Memory-mapped 32-bit float audio for the offline tools.
+
+  ==============================================================================
+*/
+
+#include "MappedAudioFile.h"
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Tools
+{
+	namespace
+	{
+		struct DataLayout
+		{
+			juce::int64 offset{}, numBytes{};
+			int numChannels{};
+			double sampleRate{};
+		};
+
+		bool hasId(const char* chunk, const char* id) noexcept
+		{
+			return std::memcmp(chunk, id, 4) == 0;
+		}
+
+		// Finds the sample data of a float WAV, or an empty layout if the file is anything else
+		DataLayout findFloatWavData(const char* file, juce::int64 fileSize) noexcept
+		{
+			DataLayout layout;
+
+			if (fileSize < 12 || !(hasId(file, "RIFF") || hasId(file, "RF64")) || !hasId(file + 8, "WAVE"))
+				return {};
+
+			juce::int64 rf64DataSize{ -1 };
+			auto isFloat = false;
+
+			for (juce::int64 position = 12; position + 8 <= fileSize;)
+			{
+				const auto* chunk = file + position;
+				auto chunkSize = (juce::int64)juce::ByteOrder::littleEndianInt(chunk + 4);
+				const auto* body = chunk + 8;
+				auto available = fileSize - (position + 8);
+
+				if (hasId(chunk, "ds64") && chunkSize >= 16 && available >= 16)
+				{
+					rf64DataSize = (juce::int64)juce::ByteOrder::littleEndianInt64(body + 8);
+				}
+				else if (hasId(chunk, "fmt ") && chunkSize >= 16 && available >= 16)
+				{
+					auto formatTag = juce::ByteOrder::littleEndianShort(body);
+					auto bitsPerSample = juce::ByteOrder::littleEndianShort(body + 14);
+
+					// WAVE_FORMAT_EXTENSIBLE keeps the real format in the first two bytes of its sub-format GUID
+					if (formatTag == 0xfffe && chunkSize >= 40 && available >= 40)
+						formatTag = juce::ByteOrder::littleEndianShort(body + 24);
+
+					isFloat = formatTag == 3 && bitsPerSample == 32;
+					layout.numChannels = (int)juce::ByteOrder::littleEndianShort(body + 2);
+					layout.sampleRate = (double)juce::ByteOrder::littleEndianInt(body + 4);
+				}
+				else if (hasId(chunk, "data"))
+				{
+					if (rf64DataSize >= 0 && chunkSize == 0xffffffff)
+						chunkSize = rf64DataSize;
+
+					layout.offset = position + 8;
+					layout.numBytes = juce::jmin(chunkSize, available);
+					break;
+				}
+
+				position += 8 + chunkSize + (chunkSize & 1);
+			}
+
+			if (!isFloat || layout.numChannels <= 0 || layout.sampleRate <= 0.0 || layout.offset == 0)
+				return {};
+
+			return layout;
+		}
+	}
+
+	MappedAudioFile::MappedAudioFile(std::unique_ptr<juce::MemoryMappedFile> mappedFile, juce::int64 offset, int channels, double rate, juce::int64 length)
+		: map(std::move(mappedFile)), dataOffset(offset), numChannels(channels), sampleRate(rate), lengthInSamples(length)
+	{
+	}
+
+	std::unique_ptr<MappedAudioFile> MappedAudioFile::openForReading(const juce::File& file, const RawFormat& rawFormat)
+	{
+	   #if JUCE_BIG_ENDIAN
+		// Both formats store little-endian samples, which can only be used in place on a little-endian host
+		juce::ignoreUnused(file, rawFormat);
+		return {};
+	   #else
+		auto map = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+
+		if (map->getData() == nullptr)
+			return {};
+
+		const auto* data = static_cast<const char*>(map->getData());
+		auto fileSize = (juce::int64)map->getSize();
+		DataLayout layout;
+
+		if (file.hasFileExtension("raw;f32;pcm"))
+		{
+			if (!rawFormat.isValid())
+				return {};
+
+			layout = { 0, fileSize, rawFormat.numChannels, rawFormat.sampleRate };
+		}
+		else
+		{
+			layout = findFloatWavData(data, fileSize);
+		}
+
+		// Frames are read as floats in place, so the data has to start on a float boundary
+		if (layout.numChannels == 0 || layout.offset % (juce::int64)sizeof(float) != 0)
+			return {};
+
+		auto frameBytes = (juce::int64)sizeof(float) * layout.numChannels;
+
+		return std::unique_ptr<MappedAudioFile>(new MappedAudioFile(std::move(map), layout.offset, layout.numChannels,
+			layout.sampleRate, layout.numBytes / frameBytes));
+	   #endif
+	}
+
+	std::unique_ptr<MappedAudioFile> MappedAudioFile::createLike(const juce::File& file, const MappedAudioFile& source)
+	{
+		const auto* sourceData = static_cast<const char*>(source.map->getData());
+		auto sourceSize = (juce::int64)source.map->getSize();
+		auto dataEnd = source.dataOffset + source.lengthInSamples * source.numChannels * (juce::int64)sizeof(float);
+
+		{
+			file.deleteFile();
+			juce::FileOutputStream stream(file);
+
+			if (stream.failedToOpen())
+				return {};
+
+			// Header and any chunks after the data are copied as they are, so metadata survives.
+			// Seeking past the header and truncating there sizes the file without writing the data.
+			stream.write(sourceData, (size_t)source.dataOffset);
+			stream.setPosition(dataEnd);
+			stream.write(sourceData + dataEnd, (size_t)(sourceSize - dataEnd));
+
+			if (stream.truncate().failed() || stream.getPosition() != sourceSize)
+				return {};
+		}
+
+		auto map = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readWrite);
+
+		if (map->getData() == nullptr || (juce::int64)map->getSize() != sourceSize)
+			return {};
+
+		return std::unique_ptr<MappedAudioFile>(new MappedAudioFile(std::move(map), source.dataOffset, source.numChannels,
+			source.sampleRate, source.lengthInSamples));
+	}
+
+	void MappedAudioFile::adviseSequential() const noexcept
+	{
+	   #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+		// madvise() wants a page-aligned start, the mapping's data pointer only has to be inside the first page
+		auto pageSize = (juce::pointer_sized_uint)sysconf(_SC_PAGESIZE);
+		auto start = (juce::pointer_sized_uint)map->getData();
+		auto alignedStart = start & ~(pageSize - 1);
+
+		madvise(reinterpret_cast<void*>(alignedStart), (size_t)(start - alignedStart + map->getSize()), MADV_SEQUENTIAL);
+	   #endif
+	}
+}
@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+	Memory-mapped 32-bit float audio for the offline tools.
+
+	Covers IEEE float WAV (plain, WAVE_FORMAT_EXTENSIBLE and RF64) and
+	headerless little-endian float files whose layout is given up front.
+	Sample frames are used straight from the mapping, with no decoder or
+	intermediate stream buffer; anything else returns nullptr so callers
+	can fall back to an AudioFormatReader.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Tools
+{
+	// Layout of headerless float files, which carry none of their own
+	struct RawFormat
+	{
+		int numChannels{};
+		double sampleRate{};
+
+		bool isValid() const noexcept { return numChannels > 0 && sampleRate > 0.0; }
+	};
+
+	class MappedAudioFile
+	{
+	public:
+		// Files with a .raw, .f32 or .pcm extension are read as rawFormat, everything else must be float WAV
+		static std::unique_ptr<MappedAudioFile> openForReading(const juce::File& file, const RawFormat& rawFormat);
+
+		// Creates file with source's header and trailing chunks and room for as many frames,
+		// mapped for writing; the sample data is left for the caller to fill
+		static std::unique_ptr<MappedAudioFile> createLike(const juce::File& file, const MappedAudioFile& source);
+
+		int getNumChannels() const noexcept { return numChannels; }
+		double getSampleRate() const noexcept { return sampleRate; }
+		juce::int64 getLengthInSamples() const noexcept { return lengthInSamples; }
+
+		// Interleaved frames from startSample on
+		const float* getFrames(juce::int64 startSample) const noexcept { return getSamples() + startSample * numChannels; }
+		float* getWritableFrames(juce::int64 startSample) const noexcept { return getSamples() + startSample * numChannels; }
+
+		// Tells the OS the mapping will be walked front to back, so it reads ahead aggressively
+		// and can drop pages behind; a no-op where that isn't supported
+		void adviseSequential() const noexcept;
+
+	private:
+		MappedAudioFile(std::unique_ptr<juce::MemoryMappedFile> map, juce::int64 dataOffset, int numChannels, double sampleRate, juce::int64 lengthInSamples);
+
+		float* getSamples() const noexcept { return reinterpret_cast<float*>(static_cast<char*>(map->getData()) + dataOffset); }
+
+		std::unique_ptr<juce::MemoryMappedFile> map;
+		juce::int64 dataOffset;
+		int numChannels;
+		double sampleRate;
+		juce::int64 lengthInSamples;
+	};
+}
@@ -0,0 +1,423 @@
+/*
+  ==============================================================================
+
+	Streams audio files through headless CompressorV2AudioProcessor instances.
+
+  ==============================================================================
+*/
+
+#include "OfflineRenderer.h"
+#include "../Dsp/Interleave.h"
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+
+namespace Tools
+{
+	OfflineRenderer::OfflineRenderer(const juce::MemoryBlock& presetState, int size)
+		: preset(presetState), blockSize(size)
+	{
+		formatManager.registerBasicFormats();
+	}
+
+	std::unique_ptr<CompressorV2AudioProcessor> OfflineRenderer::createProcessor() const
+	{
+		auto processor = std::make_unique<CompressorV2AudioProcessor>();
+		processor->setNonRealtime(true);
+
+		if (preset.getSize() > 0)
+		{
+			processor->setStateInformation(preset.getData(), (int)preset.getSize());
+		}
+
+		return processor;
+	}
+
+	std::unique_ptr<juce::AudioFormatReader> OfflineRenderer::createReader(const juce::File& file) const
+	{
+		return std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(file));
+	}
+
+	std::unique_ptr<juce::AudioFormatWriter> OfflineRenderer::createWriter(const juce::File& file, const juce::AudioFormatReader& source) const
+	{
+		auto* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+
+		if (format == nullptr)
+			return {};
+
+		// Keep the source bit depth where the output format allows it, otherwise use its deepest
+		auto bitDepths = format->getPossibleBitDepths();
+		auto bitsPerSample = bitDepths.contains((int)source.bitsPerSample) ? (int)source.bitsPerSample : bitDepths.getLast();
+
+		file.deleteFile();
+		auto stream = std::make_unique<juce::FileOutputStream>(file);
+
+		if (stream->failedToOpen())
+			return {};
+
+		std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), source.sampleRate, source.numChannels,
+			bitsPerSample, source.metadataValues, 0));
+
+		if (writer != nullptr)
+			stream.release();
+
+		return writer;
+	}
+
+	bool OfflineRenderer::prepare(CompressorV2AudioProcessor& processor, int numChannels, double sampleRate) const
+	{
+		processor.releaseResources();
+		processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+
+		if (processor.getTotalNumInputChannels() != numChannels)
+			return false;
+
+		processor.prepareToPlay(sampleRate, blockSize);
+		return true;
+	}
+
+	RenderResult OfflineRenderer::renderFile(CompressorV2AudioProcessor& processor, const juce::File& input, const juce::File& output) const
+	{
+		if (memoryMapping && output.getFileExtension() == input.getFileExtension())
+		{
+			if (auto mapped = MappedAudioFile::openForReading(input, rawFormat))
+				return renderMapped(processor, *mapped, output);
+		}
+
+		RenderResult result;
+		auto startTicks = juce::Time::getHighResolutionTicks();
+
+		auto reader = createReader(input);
+
+		if (reader == nullptr)
+		{
+			result.error = "cannot read " + input.getFullPathName();
+			return result;
+		}
+
+		auto numChannels = (int)reader->numChannels;
+
+		if (!prepare(processor, numChannels, reader->sampleRate))
+		{
+			result.error = juce::String(numChannels) + " channel layout is not supported";
+			return result;
+		}
+
+		auto writer = createWriter(output, *reader);
+
+		if (writer == nullptr)
+		{
+			result.error = "cannot write " + output.getFullPathName();
+			return result;
+		}
+
+		juce::AudioBuffer<float> buffer(numChannels, blockSize);
+		juce::MidiBuffer midi;
+
+		for (juce::int64 position = 0; position < reader->lengthInSamples; position += blockSize)
+		{
+			auto numSamples = (int)juce::jmin((juce::int64)blockSize, reader->lengthInSamples - position);
+			buffer.setSize(numChannels, numSamples, false, false, true);
+
+			reader->read(&buffer, 0, numSamples, position, true, true);
+			processor.processBlock(buffer, midi);
+
+			if (!writer->writeFromAudioSampleBuffer(buffer, 0, numSamples))
+			{
+				result.error = "write failed for " + output.getFullPathName();
+				return result;
+			}
+		}
+
+		writer.reset();
+		processor.releaseResources();
+
+		result.ok = true;
+		result.audioSeconds = (double)reader->lengthInSamples / reader->sampleRate;
+		result.wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+		return result;
+	}
+
+	RenderResult OfflineRenderer::renderMapped(CompressorV2AudioProcessor& processor, const MappedAudioFile& source, const juce::File& output) const
+	{
+		RenderResult result;
+		auto startTicks = juce::Time::getHighResolutionTicks();
+
+		auto numChannels = source.getNumChannels();
+		auto length = source.getLengthInSamples();
+
+		if (!prepare(processor, numChannels, source.getSampleRate()))
+		{
+			result.error = juce::String(numChannels) + " channel layout is not supported";
+			return result;
+		}
+
+		auto destination = MappedAudioFile::createLike(output, source);
+
+		if (destination == nullptr)
+		{
+			result.error = "cannot write " + output.getFullPathName();
+			return result;
+		}
+
+		source.adviseSequential();
+		destination->adviseSequential();
+
+		juce::AudioBuffer<float> scratch(numChannels, blockSize);
+		juce::MidiBuffer midi;
+
+		for (juce::int64 position = 0; position < length; position += blockSize)
+		{
+			auto numSamples = (int)juce::jmin((juce::int64)blockSize, length - position);
+			auto* frames = destination->getWritableFrames(position);
+
+			if (numChannels == 1)
+			{
+				// A mono data chunk already is a channel buffer, so the processor works on the output mapping itself
+				std::copy(source.getFrames(position), source.getFrames(position) + numSamples, frames);
+
+				juce::AudioBuffer<float> view(&frames, 1, numSamples);
+				processor.processBlock(view, midi);
+			}
+			else
+			{
+				scratch.setSize(numChannels, numSamples, false, false, true);
+				Dsp::deinterleave(source.getFrames(position), scratch.getArrayOfWritePointers(), numChannels, numSamples);
+				processor.processBlock(scratch, midi);
+				Dsp::interleave(scratch.getArrayOfReadPointers(), frames, numChannels, numSamples);
+			}
+		}
+
+		destination.reset();
+		processor.releaseResources();
+
+		result.ok = true;
+		result.audioSeconds = (double)length / source.getSampleRate();
+		result.wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+		return result;
+	}
+
+	RenderResult OfflineRenderer::renderFileChunked(const std::vector<std::unique_ptr<CompressorV2AudioProcessor>>& processors, WorkStealingPool& pool,
+		const juce::File& input, const juce::File& output, double segmentSeconds, float toleranceDb) const
+	{
+		jassert((int)processors.size() >= pool.getNumWorkers());
+
+		RenderResult result;
+		auto startTicks = juce::Time::getHighResolutionTicks();
+
+		auto reader = createReader(input);
+
+		if (reader == nullptr)
+		{
+			result.error = "cannot read " + input.getFullPathName();
+			return result;
+		}
+
+		auto numChannels = (int)reader->numChannels;
+		auto length = reader->lengthInSamples;
+
+		// Readers aren't thread safe, so every worker gets its own
+		std::vector<std::unique_ptr<juce::AudioFormatReader>> readers;
+
+		for (int worker = 0; worker < pool.getNumWorkers(); ++worker)
+		{
+			if (!prepare(*processors[(size_t)worker], numChannels, reader->sampleRate))
+			{
+				result.error = juce::String(numChannels) + " channel layout is not supported";
+				return result;
+			}
+
+			readers.push_back(createReader(input));
+		}
+
+		// Running auto makeup carries the whole file's history, and a pre-roll as long as the file
+		// is a serial render anyway
+		auto warmUpSamples = (juce::int64)processors.front()->getWarmUpSamples(toleranceDb);
+
+		if (warmUpSamples >= length)
+			return renderFile(*processors.front(), input, output);
+
+		auto writer = createWriter(output, *reader);
+
+		if (writer == nullptr)
+		{
+			result.error = "cannot write " + output.getFullPathName();
+			return result;
+		}
+
+		// A segment no longer than its pre-roll at most doubles the work
+		auto segmentLength = juce::jmax((juce::int64)blockSize, (juce::int64)(segmentSeconds * reader->sampleRate), warmUpSamples);
+		auto numSegments = (int)((length + segmentLength - 1) / segmentLength);
+		auto maxSegmentsInFlight = pool.getNumWorkers() * 2;
+
+		std::mutex lock;
+		std::condition_variable changed;
+		std::map<int, std::unique_ptr<juce::AudioBuffer<float>>> finished;
+		std::atomic<int> nextSegment{};
+		int nextToWrite{};
+		bool failed{};
+
+		auto renderSegment = [&](int worker)
+		{
+			// Segments are claimed in order, so the one the writer waits for is always being rendered
+			auto segment = nextSegment++;
+
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				changed.wait(guard, [&] { return failed || segment < nextToWrite + maxSegmentsInFlight; });
+
+				if (failed)
+					return;
+			}
+
+			auto& processor = *processors[(size_t)worker];
+			auto& segmentReader = *readers[(size_t)worker];
+			auto start = (juce::int64)segment * segmentLength;
+			auto end = juce::jmin(start + segmentLength, length);
+			juce::MidiBuffer midi;
+
+			processor.reset();
+
+			juce::AudioBuffer<float> preRoll(numChannels, blockSize);
+
+			// The control grid counts from the reset, so the pre-roll starts on a grid point
+			constexpr auto gridLength = (juce::int64)Dsp::Compressor::gridLength;
+			auto preRollStart = juce::jmax((juce::int64)0, start - warmUpSamples) / gridLength * gridLength;
+
+			for (auto position = preRollStart; position < start; position += blockSize)
+			{
+				auto numSamples = (int)juce::jmin((juce::int64)blockSize, start - position);
+				preRoll.setSize(numChannels, numSamples, false, false, true);
+				segmentReader.read(&preRoll, 0, numSamples, position, true, true);
+				processor.processBlock(preRoll, midi);
+			}
+
+			auto rendered = std::make_unique<juce::AudioBuffer<float>>(numChannels, (int)(end - start));
+
+			for (auto position = start; position < end; position += blockSize)
+			{
+				auto offset = (int)(position - start);
+				auto numSamples = (int)juce::jmin((juce::int64)blockSize, end - position);
+				segmentReader.read(rendered.get(), offset, numSamples, position, true, true);
+
+				juce::AudioBuffer<float> block(rendered->getArrayOfWritePointers(), numChannels, offset, numSamples);
+				processor.processBlock(block, midi);
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			finished[segment] = std::move(rendered);
+			changed.notify_all();
+		};
+
+		std::vector<WorkStealingPool::Job> jobs((size_t)numSegments, renderSegment);
+		std::thread workers([&] { pool.run(std::move(jobs)); });
+
+		for (int segment = 0; segment < numSegments; ++segment)
+		{
+			std::unique_ptr<juce::AudioBuffer<float>> rendered;
+
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				changed.wait(guard, [&] { return failed || finished.count(segment) > 0; });
+
+				if (failed)
+					break;
+
+				rendered = std::move(finished[segment]);
+				finished.erase(segment);
+			}
+
+			auto written = writer->writeFromAudioSampleBuffer(*rendered, 0, rendered->getNumSamples());
+
+			std::lock_guard<std::mutex> guard(lock);
+			failed = !written;
+			++nextToWrite;
+			changed.notify_all();
+		}
+
+		workers.join();
+
+		if (failed)
+		{
+			result.error = "write failed for " + output.getFullPathName();
+			return result;
+		}
+
+		writer.reset();
+
+		for (auto& processor : processors)
+			processor->releaseResources();
+
+		result.ok = true;
+		result.audioSeconds = (double)length / reader->sampleRate;
+		result.wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+		return result;
+	}
+
+	VerifyResult OfflineRenderer::compareFiles(const juce::File& rendered, const juce::File& reference, float toleranceDb) const
+	{
+		VerifyResult result;
+
+		auto renderedReader = createReader(rendered);
+		auto referenceReader = createReader(reference);
+
+		if (renderedReader == nullptr || referenceReader == nullptr)
+		{
+			result.error = "cannot read both renders";
+			return result;
+		}
+
+		if (renderedReader->numChannels != referenceReader->numChannels || renderedReader->lengthInSamples != referenceReader->lengthInSamples)
+		{
+			result.error = "renders differ in length or channel count";
+			return result;
+		}
+
+		// Both renders were rounded to the output format, so they can differ by a whole step of it anywhere
+		auto floor = 1.0e-6f;
+
+		if (!renderedReader->usesFloatingPointData && renderedReader->bitsPerSample > 0)
+			floor = juce::jmax(floor, std::ldexp(1.f, 1 - (int)renderedReader->bitsPerSample));
+
+		auto allowedRatio = juce::Decibels::decibelsToGain(toleranceDb) - 1.f;
+		auto numChannels = (int)referenceReader->numChannels;
+		auto length = referenceReader->lengthInSamples;
+
+		juce::AudioBuffer<float> a(numChannels, blockSize), b(numChannels, blockSize);
+		float maxDifference{}, maxRatio{};
+		result.ok = true;
+
+		for (juce::int64 position = 0; position < length; position += blockSize)
+		{
+			auto numSamples = (int)juce::jmin((juce::int64)blockSize, length - position);
+			renderedReader->read(&a, 0, numSamples, position, true, true);
+			referenceReader->read(&b, 0, numSamples, position, true, true);
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				auto* x = a.getReadPointer(channel);
+				auto* y = b.getReadPointer(channel);
+
+				for (int i = 0; i < numSamples; ++i)
+				{
+					auto difference = std::abs(x[i] - y[i]);
+					auto magnitude = std::abs(y[i]);
+
+					maxDifference = juce::jmax(maxDifference, difference);
+
+					if (magnitude > floor)
+						maxRatio = juce::jmax(maxRatio, difference / magnitude);
+
+					if (difference > magnitude * allowedRatio + floor)
+						result.ok = false;
+				}
+			}
+		}
+
+		result.maxDifferenceDb = juce::Decibels::gainToDecibels(maxDifference, -200.f);
+		result.maxDeviationDb = juce::Decibels::gainToDecibels(1.f + maxRatio);
+		return result;
+	}
+}
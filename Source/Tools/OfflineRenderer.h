@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+	Streams audio files through headless CompressorV2AudioProcessor instances.
+
+	Files are read and written one block at a time, so memory use does not
+	grow with file length. Float WAV and raw float files are memory-mapped
+	instead of decoded: mono is processed in place in the output mapping,
+	interleaved files go through one block of deinterleaved scratch. Each
+	processor instance must only be used by one thread at a time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+#include "MappedAudioFile.h"
+#include "WorkStealingPool.h"
+
+namespace Tools
+{
+	struct RenderResult
+	{
+		bool ok{};
+		juce::String error;
+		double audioSeconds{}, wallSeconds{};
+
+		double getRealTimeFactor() const { return wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0; }
+	};
+
+	struct VerifyResult
+	{
+		bool ok{};
+		juce::String error;
+		float maxDifferenceDb{ -std::numeric_limits<float>::infinity() };  // largest sample difference, dBFS
+		float maxDeviationDb{};                                              // largest difference relative to the reference sample
+	};
+
+	class OfflineRenderer
+	{
+	public:
+		// presetState is in getStateInformation() format, empty for default parameters
+		OfflineRenderer(const juce::MemoryBlock& presetState, int blockSize);
+
+		// Creates a processor with the preset applied; call on the message thread
+		std::unique_ptr<CompressorV2AudioProcessor> createProcessor() const;
+
+		// Uses the memory-mapped path when the input allows it and mapping is enabled
+		RenderResult renderFile(CompressorV2AudioProcessor& processor, const juce::File& input, const juce::File& output) const;
+
+		// Renders one file on every worker of the pool: the file is cut into segments, each segment's
+		// envelope is pre-rolled from the audio before it until it is within toleranceDb of a serial
+		// render, and the segments are written back in order. Segments are at least as long as the
+		// pre-roll; if that covers the whole file, as it always does with Running auto makeup, the
+		// file is rendered serially instead. Needs one processor per pool worker.
+		RenderResult renderFileChunked(const std::vector<std::unique_ptr<CompressorV2AudioProcessor>>& processors, WorkStealingPool& pool,
+			const juce::File& input, const juce::File& output, double segmentSeconds, float toleranceDb) const;
+
+		// Compares a render against a reference render; passes if every sample is within toleranceDb
+		// of the reference, give or take one step of the file's sample format (at least -120 dBFS),
+		// since both renders were rounded to it independently
+		VerifyResult compareFiles(const juce::File& rendered, const juce::File& reference, float toleranceDb) const;
+
+		std::unique_ptr<juce::AudioFormatReader> createReader(const juce::File& file) const;
+		std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File& file, const juce::AudioFormatReader& source) const;
+
+		// Sets the processor up for a file's layout and rate; false if the layout isn't supported
+		bool prepare(CompressorV2AudioProcessor& processor, int numChannels, double sampleRate) const;
+
+		int getBlockSize() const noexcept { return blockSize; }
+
+		void setMemoryMappingEnabled(bool shouldMap) noexcept { memoryMapping = shouldMap; }
+		void setRawFormat(const RawFormat& format) noexcept { rawFormat = format; }
+
+	private:
+		RenderResult renderMapped(CompressorV2AudioProcessor& processor, const MappedAudioFile& source, const juce::File& output) const;
+
+		// createReaderFor() is non-const but doesn't change the registered formats
+		mutable juce::AudioFormatManager formatManager;
+		juce::MemoryBlock preset;
+		int blockSize;
+		bool memoryMapping{ true };
+		RawFormat rawFormat;
+	};
+}
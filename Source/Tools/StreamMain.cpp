@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+	CompressorV2Stream: runs the compressor as a sidecar on live PCM.
+
+	CompressorV2Stream [--socket <path>] [--control <path>] [--preset <file>]
+	                   [--channels <n>] [--rate <hz>] [--quantum <n>] [--buffers <n>]
+
+	Interleaved 32-bit float PCM in, the same out. Without --socket it
+	reads stdin and writes stdout, and exits when stdin ends. With --socket
+	it listens on a Unix socket and serves one client at a time, reading and
+	writing on the same connection, until interrupted.
+
+	--control listens on a second Unix socket for parameter changes, see
+	StreamingHost.h. Counters are printed to stderr when a stream ends.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "StreamingHost.h"
+
+#include <csignal>
+#include <iostream>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+	std::atomic<Tools::StreamingHost*> activeHost{};
+
+	void handleSignal(int)
+	{
+		if (auto* host = activeHost.load())
+			host->stop();
+	}
+
+	void printUsage()
+	{
+		std::cerr << "Usage: CompressorV2Stream [--socket <path>] [--control <path>] [--preset <file>]\n"
+			"                          [--channels <n>] [--rate <hz>] [--quantum <n>] [--buffers <n>]\n";
+	}
+
+	int listenOn(const juce::String& path)
+	{
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+
+		if (path.getNumBytesAsUTF8() >= sizeof(address.sun_path))
+			return -1;
+
+		path.copyToUTF8(address.sun_path, sizeof(address.sun_path));
+		unlink(address.sun_path);
+
+		auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			return -1;
+
+		if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 4) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+	juce::String socketPath, controlPath;
+	juce::File presetFile;
+	Tools::StreamingHost::Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		juce::String arg(argv[i]);
+		auto hasValue = i + 1 < argc;
+
+		if (arg == "--socket" && hasValue)
+			socketPath = argv[++i];
+		else if (arg == "--control" && hasValue)
+			controlPath = argv[++i];
+		else if (arg == "--preset" && hasValue)
+			presetFile = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+		else if (arg == "--channels" && hasValue)
+			options.numChannels = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+		else if (arg == "--rate" && hasValue)
+			options.sampleRate = juce::jmax(1.0, juce::String(argv[++i]).getDoubleValue());
+		else if (arg == "--quantum" && hasValue)
+			options.quantum = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+		else if (arg == "--buffers" && hasValue)
+			options.numQuanta = juce::jmax(2, juce::String(argv[++i]).getIntValue());
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	CompressorV2AudioProcessor processor;
+
+	if (presetFile != juce::File())
+	{
+		juce::MemoryBlock preset;
+
+		if (!presetFile.loadFileAsData(preset))
+		{
+			std::cerr << "Cannot read preset " << presetFile.getFullPathName() << "\n";
+			return 1;
+		}
+
+		processor.setStateInformation(preset.getData(), (int)preset.getSize());
+	}
+
+	Tools::StreamingHost host(processor, options);
+
+	if (!host.prepare())
+	{
+		std::cerr << options.numChannels << " channel layout is not supported\n";
+		return 1;
+	}
+
+	auto controlFd = controlPath.isNotEmpty() ? listenOn(controlPath) : -1;
+
+	if (controlPath.isNotEmpty() && controlFd < 0)
+	{
+		std::cerr << "Cannot listen on " << controlPath << "\n";
+		return 1;
+	}
+
+	// A reader that goes away shows up as a failed write rather than killing the process
+	std::signal(SIGPIPE, SIG_IGN);
+
+	// No SA_RESTART, so an interrupt also breaks out of a blocking accept()
+	struct sigaction stopAction{};
+	stopAction.sa_handler = handleSignal;
+	sigaction(SIGINT, &stopAction, nullptr);
+	sigaction(SIGTERM, &stopAction, nullptr);
+	activeHost.store(&host);
+
+	auto streamFd = socketPath.isNotEmpty() ? listenOn(socketPath) : -1;
+
+	if (socketPath.isEmpty())
+	{
+		host.stream(STDIN_FILENO, STDOUT_FILENO, controlFd);
+		std::cerr << host.getStats().toString() << "\n";
+	}
+	else if (streamFd < 0)
+	{
+		std::cerr << "Cannot listen on " << socketPath << "\n";
+	}
+	else
+	{
+		while (!host.isStopping())
+		{
+			auto client = accept(streamFd, nullptr, nullptr);
+
+			if (client < 0)
+				continue;
+
+			host.stream(client, client, controlFd);
+			close(client);
+			std::cerr << host.getStats().toString() << "\n";
+		}
+
+		close(streamFd);
+		unlink(socketPath.toRawUTF8());
+	}
+
+	activeHost.store(nullptr);
+
+	if (controlFd >= 0)
+	{
+		close(controlFd);
+		unlink(controlPath.toRawUTF8());
+	}
+
+	return socketPath.isNotEmpty() && streamFd < 0 ? 1 : 0;
+}
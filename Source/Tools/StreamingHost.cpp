@@ -0,0 +1,407 @@
+/*
+  ==============================================================================
+
+	Runs a processor on a live stream of interleaved float PCM (POSIX only).
+
+  ==============================================================================
+*/
+
+#include "StreamingHost.h"
+#include "../Dsp/Interleave.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Tools
+{
+	namespace
+	{
+		void setNonBlocking(int fd)
+		{
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		}
+
+		bool wouldBlock() noexcept
+		{
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+	}
+
+	juce::String StreamStats::toString() const
+	{
+		return juce::String(quantaProcessed) + " quanta, " + juce::String(underruns) + " underruns, " + juce::String(stalls)
+			+ " stalls, latency " + juce::String(meanLatencyMs, 3) + " ms mean, " + juce::String(maxLatencyMs, 3) + " ms max";
+	}
+
+	StreamingHost::StreamingHost(CompressorV2AudioProcessor& p, const Options& o)
+		: juce::Thread("CompressorV2 stream audio"),
+		processor(p),
+		options(o),
+		frameBytes((int)sizeof(float) * o.numChannels),
+		inputFifo(o.quantum * o.numQuanta + 1),
+		outputFifo(o.quantum * o.numQuanta + 1),
+		inputRing((size_t)(inputFifo.getTotalSize() * o.numChannels)),
+		outputRing((size_t)(outputFifo.getTotalSize() * o.numChannels)),
+		inputBytes((size_t)(o.quantum * frameBytes)),
+		outputBytes((size_t)(outputFifo.getTotalSize() * frameBytes))
+	{
+		if (pipe(wakePipe) == 0)
+		{
+			setNonBlocking(wakePipe[0]);
+			setNonBlocking(wakePipe[1]);
+		}
+	}
+
+	StreamingHost::~StreamingHost()
+	{
+		stopThread(1000);
+
+		for (auto fd : wakePipe)
+			if (fd >= 0)
+				close(fd);
+	}
+
+	bool StreamingHost::prepare()
+	{
+		processor.releaseResources();
+		processor.setPlayConfigDetails(options.numChannels, options.numChannels, options.sampleRate, options.quantum);
+
+		if (processor.getTotalNumInputChannels() != options.numChannels)
+			return false;
+
+		processor.prepareToPlay(options.sampleRate, options.quantum);
+		return true;
+	}
+
+	void StreamingHost::stop() noexcept
+	{
+		stopping.store(true);
+		wakeIo();
+	}
+
+	void StreamingHost::wakeIo() noexcept
+	{
+		char byte{};
+		[[maybe_unused]] auto written = write(wakePipe[1], &byte, 1);
+	}
+
+	StreamStats StreamingHost::getStats() const
+	{
+		StreamStats stats;
+		stats.quantaProcessed = quantaProcessed.load();
+		stats.underruns = underruns.load();
+		stats.stalls = stalls.load();
+		stats.meanLatencyMs = numLatencies > 0 ? totalLatencyMs / (double)numLatencies : 0.0;
+		stats.maxLatencyMs = maxLatencyMs;
+		return stats;
+	}
+
+	//==============================================================================
+	void StreamingHost::stream(int inputFd, int outputFd, int controlFd)
+	{
+		setNonBlocking(inputFd);
+		setNonBlocking(outputFd);
+
+		processor.reset();
+		inputFifo.reset();
+		outputFifo.reset();
+		inputFill = outputFill = outputSent = 0;
+		inputOpen = true;
+		inputEnded.store(false);
+		processingFinished.store(false);
+		quantumArrivals.clear();
+		framesRead = framesWritten = 0;
+
+		quantaProcessed.store(0);
+		underruns.store(0);
+		stalls.store(0);
+		numLatencies = 0;
+		totalLatencyMs = maxLatencyMs = 0.0;
+
+		startThread(juce::Thread::Priority::highest);
+
+		std::vector<pollfd> fds;
+
+		while (!stopping.load())
+		{
+			if (processingFinished.load() && outputFifo.getNumReady() == 0 && outputSent == outputFill)
+				break;
+
+			fds.clear();
+			fds.push_back({ wakePipe[0], POLLIN, 0 });
+
+			// Only ask for input while there is room for it: this is where backpressure comes from
+			auto wantInput = inputOpen && inputFill < inputBytes.size();
+			auto wantOutput = outputSent < outputFill || outputFifo.getNumReady() > 0;
+
+			fds.push_back({ wantInput ? inputFd : -1, POLLIN, 0 });
+			fds.push_back({ wantOutput ? outputFd : -1, POLLOUT, 0 });
+			fds.push_back({ controlFd, POLLIN, 0 });
+
+			for (auto& client : controlClients)
+				fds.push_back({ client.fd, POLLIN, 0 });
+
+			if (poll(fds.data(), (nfds_t)fds.size(), 100) < 0 && errno != EINTR)
+				break;
+
+			if (fds[0].revents != 0)
+			{
+				char drain[64];
+				while (read(wakePipe[0], drain, sizeof(drain)) > 0) {}
+			}
+
+			if (fds[1].revents != 0)
+				readInput(inputFd);
+
+			pushInput();
+
+			if (wantOutput || outputFifo.getNumReady() > 0)
+				if (!writeOutput(outputFd))
+					break;
+
+			if (fds[3].revents & POLLIN)
+				acceptControl(controlFd);
+
+			for (size_t i = 4; i < fds.size(); ++i)
+				if (fds[i].revents != 0 && !readControl(controlClients[i - 4]))
+					controlClients[i - 4].fd = -1;
+
+			controlClients.erase(std::remove_if(controlClients.begin(), controlClients.end(), [](const ControlClient& c) { return c.fd < 0; }),
+				controlClients.end());
+		}
+
+		signalThreadShouldExit();
+		dataReady.signal();
+		stopThread(1000);
+	}
+
+	void StreamingHost::readInput(int inputFd)
+	{
+		auto numRead = read(inputFd, inputBytes.data() + inputFill, inputBytes.size() - inputFill);
+
+		if (numRead > 0)
+		{
+			auto framesBefore = (framesRead + (juce::int64)(inputFill / (size_t)frameBytes)) / options.quantum;
+			inputFill += (size_t)numRead;
+			auto framesAfter = (framesRead + (juce::int64)(inputFill / (size_t)frameBytes)) / options.quantum;
+
+			// Every quantum completed by this read is stamped now, for the latency figures
+			for (auto i = framesBefore; i < framesAfter; ++i)
+				quantumArrivals.push_back(juce::Time::getHighResolutionTicks());
+		}
+		else if (numRead == 0 || !wouldBlock())
+		{
+			inputOpen = false;
+		}
+	}
+
+	void StreamingHost::pushInput()
+	{
+		auto numFrames = juce::jmin((int)(inputFill / (size_t)frameBytes), inputFifo.getFreeSpace());
+
+		if (numFrames > 0)
+		{
+			const auto* source = reinterpret_cast<const float*>(inputBytes.data());
+			const auto scope = inputFifo.write(numFrames);
+
+			std::copy(source, source + scope.blockSize1 * options.numChannels, inputRing.data() + scope.startIndex1 * options.numChannels);
+			std::copy(source + scope.blockSize1 * options.numChannels, source + numFrames * options.numChannels,
+				inputRing.data() + scope.startIndex2 * options.numChannels);
+
+			auto numBytes = (size_t)(numFrames * frameBytes);
+			std::memmove(inputBytes.data(), inputBytes.data() + numBytes, inputFill - numBytes);
+			inputFill -= numBytes;
+			framesRead += numFrames;
+
+			dataReady.signal();
+		}
+
+		// A trailing partial frame can never be completed, so it is dropped with the end of the stream
+		if (!inputOpen && inputFill < (size_t)frameBytes && !inputEnded.load())
+		{
+			inputEnded.store(true);
+			dataReady.signal();
+		}
+	}
+
+	bool StreamingHost::writeOutput(int outputFd)
+	{
+		if (outputSent == outputFill)
+		{
+			outputSent = outputFill = 0;
+
+			auto numFrames = outputFifo.getNumReady();
+
+			if (numFrames == 0)
+				return true;
+
+			auto* destination = reinterpret_cast<float*>(outputBytes.data());
+			const auto scope = outputFifo.read(numFrames);
+
+			std::copy(outputRing.data() + scope.startIndex1 * options.numChannels,
+				outputRing.data() + (scope.startIndex1 + scope.blockSize1) * options.numChannels, destination);
+			std::copy(outputRing.data() + scope.startIndex2 * options.numChannels,
+				outputRing.data() + (scope.startIndex2 + scope.blockSize2) * options.numChannels, destination + scope.blockSize1 * options.numChannels);
+
+			outputFill = (size_t)(numFrames * frameBytes);
+			dataReady.signal();
+		}
+
+		auto numWritten = write(outputFd, outputBytes.data() + outputSent, outputFill - outputSent);
+
+		if (numWritten < 0)
+			return wouldBlock();
+
+		auto quantaBefore = (framesWritten + (juce::int64)(outputSent / (size_t)frameBytes)) / options.quantum;
+		outputSent += (size_t)numWritten;
+		auto quantaAfter = (framesWritten + (juce::int64)(outputSent / (size_t)frameBytes)) / options.quantum;
+
+		auto now = juce::Time::getHighResolutionTicks();
+
+		for (auto i = quantaBefore; i < quantaAfter && !quantumArrivals.empty(); ++i)
+		{
+			auto latencyMs = juce::Time::highResolutionTicksToSeconds(now - quantumArrivals.front()) * 1000.0;
+			quantumArrivals.pop_front();
+
+			totalLatencyMs += latencyMs;
+			maxLatencyMs = juce::jmax(maxLatencyMs, latencyMs);
+			++numLatencies;
+		}
+
+		if (outputSent == outputFill)
+			framesWritten += (juce::int64)(outputFill / (size_t)frameBytes);
+
+		return true;
+	}
+
+	//==============================================================================
+	void StreamingHost::acceptControl(int controlFd)
+	{
+		auto fd = accept(controlFd, nullptr, nullptr);
+
+		if (fd >= 0)
+		{
+			setNonBlocking(fd);
+			controlClients.push_back({ fd, {} });
+		}
+	}
+
+	bool StreamingHost::readControl(ControlClient& client)
+	{
+		char buffer[256];
+		auto numRead = read(client.fd, buffer, sizeof(buffer));
+
+		if (numRead < 0 && wouldBlock())
+			return true;
+
+		if (numRead <= 0)
+		{
+			close(client.fd);
+			return false;
+		}
+
+		client.pending.append(buffer, (size_t)numRead);
+
+		for (auto end = client.pending.find('\n'); end != std::string::npos; end = client.pending.find('\n'))
+		{
+			auto reply = handleCommand(juce::String(client.pending.substr(0, end)).trim()) + "\n";
+			client.pending.erase(0, end + 1);
+
+			// Replies are short, a control client that doesn't read them just misses them
+			[[maybe_unused]] auto written = write(client.fd, reply.toRawUTF8(), reply.getNumBytesAsUTF8());
+		}
+
+		return true;
+	}
+
+	juce::String StreamingHost::handleCommand(const juce::String& line)
+	{
+		if (line == "stats")
+			return getStats().toString();
+
+		auto id = line.upToFirstOccurrenceOf(" ", false, false);
+		auto value = line.fromFirstOccurrenceOf(" ", false, false).trim();
+
+		auto* parameter = dynamic_cast<juce::RangedAudioParameter*>(processor.apvts.getParameter(id));
+
+		if (parameter == nullptr || value.isEmpty())
+			return "error: expected <ParameterID> <value> or stats";
+
+		// The processor reads parameters at the start of every block, so this lands on the next quantum
+		parameter->setValueNotifyingHost(parameter->convertTo0to1(value.getFloatValue()));
+		return "ok " + id + " " + juce::String(parameter->convertFrom0to1(parameter->getValue()));
+	}
+
+	//==============================================================================
+	void StreamingHost::run()
+	{
+		const auto channels = options.numChannels;
+		const auto quantumTicks = juce::Time::secondsToHighResolutionTicks(options.quantum / options.sampleRate);
+		const auto waitMs = juce::jmax(1, (int)(1000.0 * options.quantum / options.sampleRate));
+
+		std::vector<float> frames((size_t)(options.quantum * channels));
+		juce::AudioBuffer<float> buffer(channels, options.quantum);
+		juce::MidiBuffer midi;
+
+		auto lastQuantumTicks = juce::Time::getHighResolutionTicks();
+		bool starved{}, blocked{};
+
+		while (!threadShouldExit())
+		{
+			auto available = inputFifo.getNumReady();
+			auto ended = inputEnded.load();
+			auto numFrames = available >= options.quantum ? options.quantum : (ended ? available : 0);
+
+			if (numFrames > 0 && outputFifo.getFreeSpace() >= numFrames)
+			{
+				{
+					const auto scope = inputFifo.read(numFrames);
+					std::copy(inputRing.data() + scope.startIndex1 * channels, inputRing.data() + (scope.startIndex1 + scope.blockSize1) * channels, frames.data());
+					std::copy(inputRing.data() + scope.startIndex2 * channels, inputRing.data() + (scope.startIndex2 + scope.blockSize2) * channels,
+						frames.data() + scope.blockSize1 * channels);
+				}
+
+				buffer.setSize(channels, numFrames, false, false, true);
+				Dsp::deinterleave(frames.data(), buffer.getArrayOfWritePointers(), channels, numFrames);
+				processor.processBlock(buffer, midi);
+				Dsp::interleave(buffer.getArrayOfReadPointers(), frames.data(), channels, numFrames);
+
+				{
+					const auto scope = outputFifo.write(numFrames);
+					std::copy(frames.data(), frames.data() + scope.blockSize1 * channels, outputRing.data() + scope.startIndex1 * channels);
+					std::copy(frames.data() + scope.blockSize1 * channels, frames.data() + numFrames * channels, outputRing.data() + scope.startIndex2 * channels);
+				}
+
+				++quantaProcessed;
+				lastQuantumTicks = juce::Time::getHighResolutionTicks();
+				starved = blocked = false;
+				wakeIo();
+				continue;
+			}
+
+			if (ended && available == 0)
+				break;
+
+			// Each episode counts once, however long it lasts
+			if (numFrames > 0)
+			{
+				if (!blocked)
+					++stalls;
+
+				blocked = true;
+			}
+			else if (!starved && quantaProcessed.load() > 0 && juce::Time::getHighResolutionTicks() - lastQuantumTicks > quantumTicks)
+			{
+				++underruns;
+				starved = true;
+			}
+
+			dataReady.wait(waitMs);
+		}
+
+		processingFinished.store(true);
+		wakeIo();
+	}
+}
@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+	Runs a processor on a live stream of interleaved 32-bit float PCM read
+	from one file descriptor and written to another (POSIX only).
+
+	Two threads share the work. The thread calling stream() does all I/O with
+	non-blocking descriptors and poll(); a high priority thread processes
+	fixed-size quanta. They meet in two small ring buffers of whole quanta,
+	double-buffered by default, so I/O on one quantum overlaps processing
+	of the next.
+
+	Nothing is ever dropped. When the output side can't keep up the rings
+	fill and the host stops reading its input, which pushes back on the
+	writer upstream.
+
+	Control connections take one command per line:
+		<ParameterID> <value>   set a parameter, e.g. "Threshold -18"
+		stats                   report the counters
+	Parameters are set on the I/O thread and picked up at the next quantum,
+	the audio keeps running.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
+namespace Tools
+{
+	struct StreamStats
+	{
+		juce::int64 quantaProcessed{};
+		juce::int64 underruns{};    // times processing waited over a quantum's duration for input
+		juce::int64 stalls{};       // times processing waited for the output to drain
+		double meanLatencyMs{}, maxLatencyMs{};   // last input byte of a quantum read to last output byte written
+
+		juce::String toString() const;
+	};
+
+	class StreamingHost : private juce::Thread
+	{
+	public:
+		struct Options
+		{
+			int numChannels{ 2 };
+			double sampleRate{ 48000.0 };
+			int quantum{ 64 };
+			int numQuanta{ 2 };
+		};
+
+		StreamingHost(CompressorV2AudioProcessor& processor, const Options& options);
+		~StreamingHost() override;
+
+		// False if the processor doesn't support the channel count
+		bool prepare();
+
+		// Streams inputFd to outputFd until the input ends and everything has been written,
+		// the output closes, or stop() is called. controlFd is a listening socket, or -1.
+		// Resets the processor first, so each call starts a fresh stream.
+		void stream(int inputFd, int outputFd, int controlFd);
+
+		// Async-signal-safe
+		void stop() noexcept;
+		bool isStopping() const noexcept { return stopping.load(); }
+
+		StreamStats getStats() const;
+
+	private:
+		struct ControlClient
+		{
+			int fd{ -1 };
+			std::string pending;
+		};
+
+		void run() override;
+		void wakeIo() noexcept;
+
+		void readInput(int inputFd);
+		void pushInput();
+		bool writeOutput(int outputFd);
+		void acceptControl(int controlFd);
+		bool readControl(ControlClient& client);
+		juce::String handleCommand(const juce::String& line);
+
+		CompressorV2AudioProcessor& processor;
+		const Options options;
+		const int frameBytes;
+
+		juce::AbstractFifo inputFifo, outputFifo;
+		std::vector<float> inputRing, outputRing;
+
+		std::vector<char> inputBytes, outputBytes;
+		size_t inputFill{}, outputFill{}, outputSent{};
+		bool inputOpen{};
+
+		int wakePipe[2]{ -1, -1 };
+		juce::WaitableEvent dataReady;
+		std::atomic<bool> inputEnded{}, processingFinished{}, stopping{};
+
+		std::atomic<juce::int64> quantaProcessed{}, underruns{}, stalls{};
+
+		// I/O thread only
+		std::deque<juce::int64> quantumArrivals;
+		juce::int64 framesRead{}, framesWritten{}, numLatencies{};
+		double totalLatencyMs{}, maxLatencyMs{};
+		std::vector<ControlClient> controlClients;
+
+		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StreamingHost)
+	};
+}
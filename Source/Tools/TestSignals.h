@@ -0,0 +1,165 @@
+/*
+  ==============================================================================
+
+	Deterministic test signals for the accuracy tool, JUCE-free.
+
+	Every signal is generated from fixed seeds, so two runs (or two commits)
+	see exactly the same samples. Extra channels carry a quieter copy, or
+	independent noise, so the linked detector has something to link.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace Tools
+{
+	struct TestSignal
+	{
+		std::string name;
+		double sampleRate{};
+		std::vector<std::vector<float>> channels;
+
+		// Sample positions where the level steps up and back down, for timing checks
+		std::vector<int> onsets, offsets;
+
+		int getNumSamples() const noexcept { return channels.empty() ? 0 : (int)channels.front().size(); }
+	};
+
+	namespace Signals
+	{
+		constexpr double twoPi{ 6.283185307179586 };
+
+		inline TestSignal makeEmpty(const std::string& name, double sampleRate, int numChannels, double seconds)
+		{
+			TestSignal signal;
+			signal.name = name;
+			signal.sampleRate = sampleRate;
+			signal.channels.assign((size_t)numChannels, std::vector<float>((size_t)(seconds * sampleRate)));
+			return signal;
+		}
+
+		// Channels after the first get the first one 3 dB down
+		inline void copyToOtherChannels(TestSignal& signal)
+		{
+			for (size_t channel = 1; channel < signal.channels.size(); ++channel)
+				for (size_t i = 0; i < signal.channels[channel].size(); ++i)
+					signal.channels[channel][i] = 0.7071f * signal.channels[0][i];
+		}
+
+		// Exponential 20 Hz to 20 kHz sweep at -6 dBFS
+		inline TestSignal makeSineSweep(double sampleRate, int numChannels)
+		{
+			auto signal = makeEmpty("sweep", sampleRate, numChannels, 2.0);
+			const auto duration = 2.0, f1 = 20.0, f2 = std::min(20000.0, 0.45 * sampleRate);
+			const auto rate = std::log(f2 / f1);
+
+			for (int i = 0; i < signal.getNumSamples(); ++i)
+			{
+				const auto t = i / sampleRate;
+				const auto phase = twoPi * f1 * duration / rate * (std::exp(t / duration * rate) - 1.0);
+				signal.channels[0][(size_t)i] = (float)(0.5 * std::sin(phase));
+			}
+
+			copyToOtherChannels(signal);
+			return signal;
+		}
+
+		// 1 kHz at -40 dBFS, stepping to -6 dBFS for 200 ms every 750 ms
+		inline TestSignal makeToneBursts(double sampleRate, int numChannels)
+		{
+			auto signal = makeEmpty("bursts", sampleRate, numChannels, 2.25);
+
+			for (int burst = 0; burst < 3; ++burst)
+			{
+				signal.onsets.push_back((int)((0.25 + 0.75 * burst) * sampleRate));
+				signal.offsets.push_back((int)((0.45 + 0.75 * burst) * sampleRate));
+			}
+
+			for (int i = 0; i < signal.getNumSamples(); ++i)
+			{
+				auto amplitude = 0.01;
+
+				for (size_t burst = 0; burst < signal.onsets.size(); ++burst)
+					if (i >= signal.onsets[burst] && i < signal.offsets[burst])
+						amplitude = 0.5;
+
+				signal.channels[0][(size_t)i] = (float)(amplitude * std::sin(twoPi * 1000.0 * i / sampleRate));
+			}
+
+			copyToOtherChannels(signal);
+			return signal;
+		}
+
+		// Pink noise (Paul Kellet's economy filter) at -12 dBFS RMS, independent per channel
+		inline TestSignal makePinkNoise(double sampleRate, int numChannels)
+		{
+			auto signal = makeEmpty("pink", sampleRate, numChannels, 2.0);
+			unsigned int seed{ 20240901 };
+
+			for (auto& channel : signal.channels)
+			{
+				double b0{}, b1{}, b2{}, sumSquares{};
+
+				for (auto& sample : channel)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					const auto white = (double)seed / 4294967296.0 * 2.0 - 1.0;
+
+					b0 = 0.99765 * b0 + white * 0.0990460;
+					b1 = 0.96300 * b1 + white * 0.2965164;
+					b2 = 0.57000 * b2 + white * 1.0526913;
+
+					const auto pink = b0 + b1 + b2 + white * 0.1848;
+					sample = (float)pink;
+					sumSquares += pink * pink;
+				}
+
+				const auto scale = 0.25 / std::sqrt(sumSquares / (double)channel.size());
+
+				for (auto& sample : channel)
+					sample = (float)(sample * scale);
+			}
+
+			return signal;
+		}
+
+		// Kick-like hits every 250 ms: a noise click into a decaying 60 Hz tone, over a -50 dBFS bed
+		inline TestSignal makeTransients(double sampleRate, int numChannels)
+		{
+			auto signal = makeEmpty("transients", sampleRate, numChannels, 2.0);
+			const auto period = (int)(0.25 * sampleRate);
+			const auto clickLength = (int)(0.002 * sampleRate);
+			unsigned int seed{ 777 };
+
+			for (int i = 0; i < signal.getNumSamples(); ++i)
+			{
+				const auto sinceHit = i % period;
+				const auto t = sinceHit / sampleRate;
+				auto value = 0.003 * std::sin(twoPi * 1000.0 * i / sampleRate) + 0.9 * std::exp(-t / 0.04) * std::sin(twoPi * 60.0 * t);
+
+				if (sinceHit < clickLength)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					value += 0.5 * ((double)seed / 4294967296.0 * 2.0 - 1.0);
+				}
+
+				signal.channels[0][(size_t)i] = (float)std::max(-1.0, std::min(1.0, value));
+			}
+
+			copyToOtherChannels(signal);
+			return signal;
+		}
+
+		inline std::vector<TestSignal> makeStandardSet(double sampleRate, int numChannels)
+		{
+			return { makeSineSweep(sampleRate, numChannels), makeToneBursts(sampleRate, numChannels),
+				makePinkNoise(sampleRate, numChannels), makeTransients(sampleRate, numChannels) };
+		}
+	}
+}
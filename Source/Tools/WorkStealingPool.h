@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+	Small work-stealing thread pool for the offline tools.
+
+	Each worker owns a deque: it takes jobs from the back of its own and,
+	when that runs dry, steals from the front of the others. Jobs receive
+	the index of the worker running them, so per-worker state such as a
+	processor instance can be indexed without locking.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Tools
+{
+	class WorkStealingPool
+	{
+	public:
+		using Job = std::function<void(int workerIndex)>;
+
+		explicit WorkStealingPool(int numWorkers)
+			: queues((size_t)std::max(numWorkers, 1))
+		{
+		}
+
+		int getNumWorkers() const noexcept { return (int)queues.size(); }
+
+		// Blocks until every job has run
+		void run(std::vector<Job> jobs)
+		{
+			for (size_t i = 0; i < jobs.size(); ++i)
+				queues[i % queues.size()].jobs.push_back(std::move(jobs[i]));
+
+			std::vector<std::thread> threads;
+
+			for (int worker = 1; worker < getNumWorkers(); ++worker)
+				threads.emplace_back([this, worker] { workerLoop(worker); });
+
+			workerLoop(0);
+
+			for (auto& thread : threads)
+				thread.join();
+		}
+
+	private:
+		struct Queue
+		{
+			std::mutex lock;
+			std::deque<Job> jobs;
+		};
+
+		bool popOwn(int worker, Job& job)
+		{
+			auto& queue = queues[(size_t)worker];
+			std::lock_guard<std::mutex> guard(queue.lock);
+
+			if (queue.jobs.empty())
+				return false;
+
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			return true;
+		}
+
+		bool steal(int thief, Job& job)
+		{
+			for (int offset = 1; offset < getNumWorkers(); ++offset)
+			{
+				auto& queue = queues[(size_t)((thief + offset) % getNumWorkers())];
+				std::lock_guard<std::mutex> guard(queue.lock);
+
+				if (!queue.jobs.empty())
+				{
+					job = std::move(queue.jobs.front());
+					queue.jobs.pop_front();
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void workerLoop(int worker)
+		{
+			// Jobs never enqueue more jobs, so once every queue is empty the work is done
+			Job job;
+
+			while (popOwn(worker, job) || steal(worker, job))
+				job(worker);
+		}
+
+		std::vector<Queue> queues;
+	};
+}
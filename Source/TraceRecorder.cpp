@@ -0,0 +1,156 @@
+/*
+  ==============================================================================
+
+	Opt-in timeline tracing in Chrome trace-event format (opens in Perfetto).
+
+  ==============================================================================
+*/
+
+#include "TraceRecorder.h"
+
+TraceRecorder::TraceRecorder()
+	: juce::Thread("CompressorV2 trace writer"),
+	slots(new Slot[capacity])
+{
+	for (juce::uint64 i = 0; i < capacity; ++i)
+	{
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	stop();
+}
+
+bool TraceRecorder::start(const juce::File& outputFile)
+{
+	stop();
+
+	// Throw away anything recorded after the previous session stopped
+	Event event;
+	while (pop(event)) {}
+
+	outputFile.deleteFile();
+	output = std::make_unique<juce::FileOutputStream>(outputFile);
+
+	if (output->failedToOpen())
+	{
+		output.reset();
+		return false;
+	}
+
+	*output << "[";
+	firstEvent = true;
+	threadNumbers.clear();
+	namedProcesses.clear();
+	droppedEvents.store(0, std::memory_order_relaxed);
+	startTicks = juce::Time::getHighResolutionTicks();
+
+	recording.store(true, std::memory_order_relaxed);
+	startThread(juce::Thread::Priority::low);
+	return true;
+}
+
+void TraceRecorder::stop()
+{
+	if (output == nullptr)
+		return;
+
+	recording.store(false, std::memory_order_relaxed);
+	stopThread(1000);
+
+	Event event;
+	while (pop(event))
+	{
+		writeEvent(event);
+	}
+
+	*output << "\n]\n";
+	output->flush();
+	output.reset();
+}
+
+void TraceRecorder::record(const char* name, char phase, int processId) noexcept
+{
+	auto position = writeIndex.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		auto& slot = slots[position & (capacity - 1)];
+		auto sequence = slot.sequence.load(std::memory_order_acquire);
+		auto difference = (juce::int64)(sequence - position);
+
+		if (difference == 0)
+		{
+			if (writeIndex.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				slot.event.name = name;
+				slot.event.ticks = juce::Time::getHighResolutionTicks();
+				slot.event.threadId = juce::Thread::getCurrentThreadId();
+				slot.event.processId = processId;
+				slot.event.phase = phase;
+				slot.sequence.store(position + 1, std::memory_order_release);
+				return;
+			}
+		}
+		else if (difference < 0)
+		{
+			droppedEvents.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+		{
+			position = writeIndex.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool TraceRecorder::pop(Event& event) noexcept
+{
+	auto& slot = slots[readIndex & (capacity - 1)];
+
+	if (slot.sequence.load(std::memory_order_acquire) != readIndex + 1)
+		return false;
+
+	event = slot.event;
+	slot.sequence.store(readIndex + capacity, std::memory_order_release);
+	++readIndex;
+	return true;
+}
+
+void TraceRecorder::run()
+{
+	while (!threadShouldExit())
+	{
+		Event event;
+		while (pop(event))
+		{
+			writeEvent(event);
+		}
+
+		wait(20);
+	}
+}
+
+void TraceRecorder::writeEvent(const Event& event)
+{
+	auto& stream = *output;
+
+	if (namedProcesses.insert(event.processId).second)
+	{
+		stream << (firstEvent ? "\n" : ",\n")
+			<< "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << event.processId
+			<< ",\"args\":{\"name\":\"CompressorV2 #" << event.processId << "\"}}";
+		firstEvent = false;
+	}
+
+	auto thread = threadNumbers.emplace(event.threadId, (int)threadNumbers.size() + 1).first->second;
+	auto microseconds = juce::Time::highResolutionTicksToSeconds(event.ticks - startTicks) * 1.0e6;
+
+	stream << (firstEvent ? "\n" : ",\n")
+		<< "{\"name\":\"" << event.name << "\",\"ph\":\"" << juce::String::charToString(event.phase)
+		<< "\",\"ts\":" << juce::String(microseconds, 3)
+		<< ",\"pid\":" << event.processId << ",\"tid\":" << thread << "}";
+	firstEvent = false;
+}
@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+	Opt-in timeline tracing in Chrome trace-event format (opens in Perfetto).
+
+	Begin/end events go into a preallocated lock-free ring that any thread can
+	write to without allocating or blocking. A background thread drains the
+	ring to a JSON file, so the audio thread never touches the disk. When the
+	ring is full new events are dropped and counted.
+
+	Shared by every plugin instance through juce::SharedResourcePointer, each
+	instance shows up as its own process in the trace.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class TraceRecorder : private juce::Thread
+{
+public:
+	TraceRecorder();
+	~TraceRecorder() override;
+
+	// Message thread only
+	bool start(const juce::File& outputFile);
+	void stop();
+
+	bool isRecording() const noexcept { return recording.load(std::memory_order_relaxed); }
+	juce::int64 getNumDroppedEvents() const noexcept { return droppedEvents.load(std::memory_order_relaxed); }
+
+	// Safe on any thread. The name must be a string literal, only the pointer is stored.
+	void record(const char* name, char phase, int processId) noexcept;
+
+	class ScopedEvent
+	{
+	public:
+		ScopedEvent(TraceRecorder& r, const char* n, int id) noexcept
+			: recorder(r.isRecording() ? &r : nullptr), name(n), processId(id)
+		{
+			if (recorder != nullptr)
+				recorder->record(name, 'B', processId);
+		}
+
+		~ScopedEvent()
+		{
+			if (recorder != nullptr)
+				recorder->record(name, 'E', processId);
+		}
+
+	private:
+		TraceRecorder* recorder;
+		const char* name;
+		int processId;
+
+		JUCE_DECLARE_NON_COPYABLE(ScopedEvent)
+	};
+
+private:
+	struct Event
+	{
+		const char* name{};
+		juce::int64 ticks{};
+		juce::Thread::ThreadID threadId{};
+		int processId{};
+		char phase{};
+	};
+
+	struct Slot
+	{
+		std::atomic<juce::uint64> sequence{};
+		Event event;
+	};
+
+	static constexpr juce::uint64 capacity{ 1 << 16 };
+
+	void run() override;
+	bool pop(Event& event) noexcept;
+	void writeEvent(const Event& event);
+
+	std::unique_ptr<Slot[]> slots;
+	std::atomic<juce::uint64> writeIndex{};
+	juce::uint64 readIndex{};
+
+	std::atomic<bool> recording{};
+	std::atomic<juce::int64> droppedEvents{};
+
+	std::unique_ptr<juce::FileOutputStream> output;
+	juce::int64 startTicks{};
+	bool firstEvent{ true };
+	std::map<juce::Thread::ThreadID, int> threadNumbers;
+	std::set<int> namedProcesses;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TraceRecorder)
+};